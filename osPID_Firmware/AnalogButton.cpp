@@ -2,24 +2,33 @@
 //#include "WProgram.h"
 #include "Arduino.h"
 
-AnalogButton::AnalogButton(uint8_t analogPin, int buttonValueReturn, 
+AnalogButton::AnalogButton(uint8_t analogPin, int buttonValueReturn,
 							int buttonValueUp, int buttonValueDown, int buttonValueOk)
 {
 	// Store analog pin used to multiplex push button
 	buttonPin = analogPin;
-	
-	// Add upper bound of tolerance for variation againts resistor values, temperature
-	// and other possible drift
-	buttonValueThresholdReturn = TOLERANCE*buttonValueReturn;
-	buttonValueThresholdUp = TOLERANCE*buttonValueUp;
-	buttonValueThresholdDown = TOLERANCE*buttonValueDown;
-	buttonValueThresholdOk = TOLERANCE*buttonValueOk;
+
+	// Each button takes the readings up to halfway to the next one, to allow for
+	// resistor values, temperature, other drift and noise either way of its level
+	// (return sits at 0, where a fixed percentage above leaves it no room at all)
+	buttonValueThresholdReturn = (buttonValueReturn + buttonValueUp) / 2;
+	buttonValueThresholdUp = (buttonValueUp + buttonValueDown) / 2;
+	buttonValueThresholdDown = (buttonValueDown + buttonValueOk) / 2;
+	buttonValueThresholdOk = (buttonValueOk + BUTTON_NONE_THRESHOLD) / 2;
+
+	repeatMask = (1<<BUTTON_UP) | (1<<BUTTON_DOWN);
+	buttonState = BUTTON_STATE_SCAN;
+	buttonMask = BUTTON_NONE;
+	timer = 0;
+	interval = REPEAT_START;
+	queueHead = 0;
+	queueCount = 0;
 }
 
 button_t	AnalogButton::read(void)
 {
 	int	buttonValue;
-	
+
 	buttonValue = analogRead(buttonPin);
 
 	if (buttonValue >= BUTTON_NONE_THRESHOLD)		return BUTTON_NONE;
@@ -27,60 +36,100 @@ button_t	AnalogButton::read(void)
 	if (buttonValue <= buttonValueThresholdUp)		return BUTTON_UP;
 	if (buttonValue <= buttonValueThresholdDown)	return BUTTON_DOWN;
 	if (buttonValue <= buttonValueThresholdOk)		return BUTTON_OK;
-	
+
 	return BUTTON_NONE;
 }
 
-button_t	AnalogButton::get(void)
+void	AnalogButton::push(button_t button, buttonEvent_t event)
+{
+	// When nobody is collecting, newer events are dropped
+	if (queueCount == BUTTON_QUEUE_SIZE) return;
+	queue[(queueHead + queueCount) % BUTTON_QUEUE_SIZE] = button | (event << 4);
+	queueCount++;
+}
+
+void	AnalogButton::sample(void)
 {
-	static	button_t	buttonMask;
-	static	buttonState_t	buttonState;
-	static	unsigned long debounceTimer;
-	button_t	buttonValue;
-	button_t	buttonStatus;
-	
-	// Initialize button status
-	buttonStatus = BUTTON_NONE;
-	
+	button_t	buttonValue = read();
+	unsigned long	now = millis();
+
 	switch (buttonState)
 	{
 		case BUTTON_STATE_SCAN:
-			// Retrieve current button value
-			buttonValue = read();
 			// If button press is detected
 			if (buttonValue != BUTTON_NONE)
 			{
 				// Store current button press value
 				buttonMask = buttonValue;
-				// Retrieve current time
-				debounceTimer = millis();
-				debounceTimer += DEBOUNCE_PERIOD;
+				timer = now + DEBOUNCE_PERIOD;
 				// Proceed to button debounce state
 				buttonState = BUTTON_STATE_DEBOUNCE;
 			}
 			break;
-			
+
 		case BUTTON_STATE_DEBOUNCE:
-			if (read() == buttonMask)
+			// A bounce starts the wait over
+			if (buttonValue != buttonMask)
 			{
-				// If debounce period is completed
-				if (millis() >= debounceTimer)
+				buttonState = BUTTON_STATE_SCAN;
+			}
+			// If debounce period is completed
+			else if ((long)(now - timer) >= 0)
+			{
+				push(buttonMask, BUTTON_PRESS);
+				interval = REPEAT_START;
+				if (repeatMask & (1 << buttonMask)) timer = now + REPEAT_DELAY;
+				else timer = now + LONG_PRESS_PERIOD;
+				buttonState = BUTTON_STATE_HELD;
+			}
+			break;
+
+		case BUTTON_STATE_HELD:
+			if (buttonValue != buttonMask)
+			{
+				// Released, or another button joined in: that one waits for a clean release
+				buttonState = buttonValue == BUTTON_NONE ? BUTTON_STATE_SCAN : BUTTON_STATE_RELEASE;
+			}
+			else if ((long)(now - timer) >= 0)
+			{
+				if (repeatMask & (1 << buttonMask))
 				{
-					buttonStatus = buttonMask;
-					// Proceed to wait for the button to be released
+					push(buttonMask, BUTTON_REPEAT);
+					// Each repeat comes a little sooner than the last
+					timer += interval;
+					interval -= interval / 4;
+					if (interval < REPEAT_MIN) interval = REPEAT_MIN;
+				}
+				else
+				{
+					push(buttonMask, BUTTON_LONG);
 					buttonState = BUTTON_STATE_RELEASE;
 				}
 			}
 			break;
-			
+
 		case BUTTON_STATE_RELEASE:
-			if (read() == BUTTON_NONE)
+			// Wait for the button to be released
+			if (buttonValue == BUTTON_NONE)
 			{
 				buttonMask = BUTTON_NONE;
 				buttonState = BUTTON_STATE_SCAN;
 			}
 			break;
 	}
-	
-	return (buttonStatus);
+}
+
+button_t	AnalogButton::get(buttonEvent_t *event)
+{
+	if (queueCount == 0) return BUTTON_NONE;
+	uint8_t	entry = queue[queueHead];
+	queueHead = (queueHead + 1) % BUTTON_QUEUE_SIZE;
+	queueCount--;
+	if (event) *event = (buttonEvent_t)(entry >> 4);
+	return (button_t)(entry & 0x0F);
+}
+
+void	AnalogButton::setRepeat(uint8_t mask)
+{
+	repeatMask = mask;
 }
@@ -6,7 +6,7 @@
 enum button_t
 {
 	BUTTON_NONE,
-	BUTTON_RETURN,	
+	BUTTON_RETURN,
 	BUTTON_UP,
 	BUTTON_DOWN,
 	BUTTON_OK
@@ -15,33 +15,60 @@ enum button_t
 enum buttonState_t
 {
 	BUTTON_STATE_SCAN,
-	BUTTON_STATE_DEBOUNCE,	
+	BUTTON_STATE_DEBOUNCE,
+	BUTTON_STATE_HELD,
 	BUTTON_STATE_RELEASE
 };
 
-#define	BUTTON_NONE_THRESHOLD 1000	
-#define	TOLERANCE 1.1
+enum buttonEvent_t
+{
+	BUTTON_PRESS,		// the button went down
+	BUTTON_REPEAT,		// still held, a button that repeats
+	BUTTON_LONG			// still held, a button that doesn't (once per press)
+};
+
+#define	BUTTON_NONE_THRESHOLD 1000
 #define	DEBOUNCE_PERIOD	100
+#define	LONG_PRESS_PERIOD 1000	// held this long for a long press
+#define	REPEAT_DELAY 500		// held this long before repeating starts
+#define	REPEAT_START 250		// first repeat interval, shortened by a quarter
+#define	REPEAT_MIN 40			// each repeat down to this
+#define	BUTTON_QUEUE_SIZE 4		// events waiting to be collected
 
-class AnalogButton 
+class AnalogButton
 {
 	public:
-		AnalogButton(uint8_t analogPin, int buttonValueReturn, 
-					 int buttonValueUp, int buttonValueDown, 
+		AnalogButton(uint8_t analogPin, int buttonValueReturn,
+					 int buttonValueUp, int buttonValueDown,
 					 int buttonValueOk);
-		
-		button_t	get(void);
-		
+
+		// Reads the pin and queues whatever happened. call it every 10ms or so
+		void		sample(void);
+		// Next event in the queue, BUTTON_NONE once it's empty
+		button_t	get(buttonEvent_t *event = 0);
+		// Buttons (1<<button_t) that repeat while held. up and down to start with
+		void		setRepeat(uint8_t mask);
+
 	private:
 		button_t	read(void);
-		
-		// Analog pin used as button multiplexer	
-		uint8_t buttonPin; 
+		void		push(button_t button, buttonEvent_t event);
+
+		// Analog pin used as button multiplexer
+		uint8_t buttonPin;
 		// Upper boound ADC value for each button
 		int buttonValueThresholdReturn;
 		int buttonValueThresholdUp;
 		int buttonValueThresholdDown;
 		int buttonValueThresholdOk;
+
+		uint8_t repeatMask;
+		buttonState_t buttonState;
+		button_t buttonMask;
+		unsigned long timer;		// when the current state is next due
+		unsigned int interval;		// current repeat interval
+		// events, button in the low nibble and buttonEvent_t in the high one
+		uint8_t queue[BUTTON_QUEUE_SIZE];
+		uint8_t queueHead, queueCount;
 };
 
 #endif
@@ -0,0 +1,268 @@
+#include "DigitalOutputCard_local.h"
+#include "EEPROMAnything.h"
+#include "NumberFormat_local.h"
+
+const byte RelayPin = 5;
+const byte SSRPin = 6;
+const float maxDeadband = 50;
+const unsigned long cycleSaveInterval = 3600000; //ms.  an EEPROM cell is good for 100,000 writes
+
+DigitalOutputCard::DigitalOutputCard()
+{
+  outputType = 1;
+  windowSec = 5.0;
+  windowSize = 5000;
+  coolWindowSec = 20.0;
+  coolWindowSize = 20000;
+  deadband = 0;
+  heatGain = 1;
+  coolGain = 1;
+  minOn = 0;
+  minOff = 0;
+  relayCycles = 0;
+  ssrCycles = 0;
+  relayDebt = 0;
+  relayStart = 0;
+  relayOnFor = 0;
+  relayLast = 0;
+  relayState = LOW;
+  ssrState = LOW;
+  cycleOffset = 0;
+  cyclesSaved = 0;
+  cyclesChanged = false;
+}
+
+void DigitalOutputCard::SetWindow(double val)
+{
+  unsigned long temp = (unsigned long)(val*1000);
+  if(temp<500)temp = 500;
+  windowSec = (double)temp/1000;
+  windowSize = temp;
+}
+
+void DigitalOutputCard::SetCoolWindow(double val)
+{
+  unsigned long temp = (unsigned long)(val*1000);
+  if(temp<500)temp = 500;
+  coolWindowSec = (double)temp/1000;
+  coolWindowSize = temp;
+}
+
+double DigitalOutputCard::OutputMin()
+{
+  return outputType==2 ? -100 : 0;
+}
+
+void DigitalOutputCard::BackupParams(int offset)
+{
+  EEPROM.write(offset, outputType);
+  EEPROM_writeAnything(offset+1, windowSize);
+  EEPROM_writeAnything(offset+5, coolWindowSize);
+  EEPROM_writeAnything(offset+9, deadband);
+  EEPROM_writeAnything(offset+13, heatGain);
+  EEPROM_writeAnything(offset+17, coolGain);
+  EEPROM.write(offset+21, minOn);
+  EEPROM.write(offset+22, minOff);
+  cycleOffset = offset+24;
+  EEPROM_writeAnything(cycleOffset, relayCycles);
+  EEPROM_writeAnything(cycleOffset+4, ssrCycles);
+  cyclesSaved = millis();
+  cyclesChanged = false;
+}
+
+void DigitalOutputCard::RestoreParams(int offset)
+{
+  byte type = EEPROM.read(offset);
+  if(type > 2) type = 0;
+  if(outputType != type)
+  {
+    Disable(); //a config blob can change it while the card is running
+    outputType = type;
+  }
+  EEPROM_readAnything(offset+1, windowSize);
+  SetWindow((double)windowSize/1000);
+  EEPROM_readAnything(offset+5, coolWindowSize);
+  EEPROM_readAnything(offset+9, deadband);
+  EEPROM_readAnything(offset+13, heatGain);
+  EEPROM_readAnything(offset+17, coolGain);
+  //settings from before split range was added read back as 0s
+  SetCoolWindow(coolWindowSize<500 ? 20.0 : (double)coolWindowSize/1000);
+  if(!(deadband>=0 && deadband<=maxDeadband)) deadband = 0;
+  if(!(heatGain>0)) heatGain = 1;
+  if(!(coolGain>0)) coolGain = 1;
+  minOn = EEPROM.read(offset+21);
+  minOff = EEPROM.read(offset+22);
+
+  //the counts only go up, so whichever is higher is the latest (this also runs when a
+  //config blob is loaded, with counts in RAM that haven't been saved yet)
+  cycleOffset = offset+24;
+  unsigned long saved;
+  EEPROM_readAnything(cycleOffset, saved);
+  if(saved>relayCycles) relayCycles = saved;
+  EEPROM_readAnything(cycleOffset+4, saved);
+  if(saved>ssrCycles) ssrCycles = saved;
+}
+
+void DigitalOutputCard::Initialize()
+{
+  pinMode(RelayPin, OUTPUT);
+  pinMode(SSRPin, OUTPUT);
+}
+
+void DigitalOutputCard::SerialReceiveStart()
+{
+  received = 0;
+}
+
+void DigitalOutputCard::SerialReceiveDuring(byte val, byte index)
+{
+  if(index==22 || index==23) newMin[index-22] = val;
+  else message.Receive(val, index);
+  received = index;
+}
+
+void DigitalOutputCard::SerialReceiveAfter(int offset)
+{
+  byte type = message.asBytes[0];
+  if(type > 2) return; //no such output: the settings are left as they were
+  if(outputType != type)
+  {
+    Disable(); //the pin that's no longer used stays off
+    outputType=type;
+  }
+  SetWindow(message.asFloat[0]);
+  if(received>=21)
+  { //the split range settings are optional
+    SetCoolWindow(message.asFloat[1]);
+    deadband = constrain(message.asFloat[2], 0, maxDeadband);
+    if(message.asFloat[3]>0) heatGain = message.asFloat[3];
+    if(message.asFloat[4]>0) coolGain = message.asFloat[4];
+  }
+  if(received>=23)
+  {
+    minOn = newMin[0];
+    minOff = newMin[1];
+  }
+  BackupParams(offset);
+}
+
+void DigitalOutputCard::SerialID()
+{
+  Serial.print(F(" OID1"));
+}
+
+// called from the watchdog interrupt, so keep it short
+void DigitalOutputCard::Disable()
+{
+  digitalWrite(RelayPin, LOW);
+  digitalWrite(SSRPin, LOW);
+  relayState = LOW;
+  ssrState = LOW;
+}
+
+// whether a pin time proportioned to value (0-100, more is on all the time) is on right now
+static byte WindowOn(double value, unsigned long window)
+{
+  unsigned long wind = millis() % window;
+  unsigned long oVal = (unsigned long)(value*(double)window/ 100.0);
+  return (oVal>wind) ? HIGH : LOW;
+}
+
+// the relay, time proportioned to value with the minimum on and off times.  the on time
+// owed is tracked continuously (the output's share of the time gone by, less the time the
+// relay has been on) and at the start of each window all of it is planned as one pulse at
+// the start of the window.  a plan shorter than the minimum on time becomes no pulse,
+// and one that leaves less than the minimum off time becomes the whole window; either
+// way what wasn't delivered stays owed, so the next windows make up for it.  a 0 output
+// turns the relay off at once, minimum or not, and forgets what's owed
+byte DigitalOutputCard::Relay(double value, unsigned long window)
+{
+  if(minOn==0 && minOff==0) return WindowOn(value, window);
+  unsigned long now = millis();
+  unsigned long onMin = min(minOn*1000UL, window/2), offMin = min(minOff*1000UL, window/2);
+  if(value>100) value = 100;
+
+  if(value<=0)
+  {
+    relayDebt = 0;
+    relayOnFor = 0;
+    if(relayState==HIGH) relayStart = now; //so the off time starts from here
+  }
+  else
+  {
+    relayDebt += value*(now-relayLast)/100;
+    if(relayState==HIGH) relayDebt -= now-relayLast;
+    if(relayDebt>window) relayDebt = window;
+    else if(relayDebt<-(float)window) relayDebt = -(float)window;
+  }
+  relayLast = now;
+
+  if(now-relayStart >= window)
+  {
+    relayStart = now;
+    float plan = relayDebt;
+    if(plan<onMin) relayOnFor = 0;
+    else if(plan>window-offMin) relayOnFor = window;
+    else relayOnFor = (unsigned long)plan;
+  }
+  return (now-relayStart < relayOnFor) ? HIGH : LOW;
+}
+
+// drives a pin, counting the times it switches on
+void DigitalOutputCard::Set(byte pin, byte val, byte *state, unsigned long *cycles)
+{
+  if(val==HIGH && *state==LOW)
+  {
+    (*cycles)++;
+    cyclesChanged = true;
+  }
+  *state = val;
+  digitalWrite(pin, val);
+}
+
+void DigitalOutputCard::Write(double value)
+{
+  if(outputType == 0) Set(RelayPin, Relay(value, windowSize), &relayState, &relayCycles);
+  else if(outputType == 1) Set(SSRPin, WindowOn(value, windowSize), &ssrState, &ssrCycles);
+  else if(outputType == 2)
+  {
+    //each side starts from 0 at the edge of the deadband and reaches 100 (times its gain) at the end
+    double half = deadband/2, scale = 100/(100-half);
+    double heat = value>half ? (value-half)*scale*heatGain : 0;
+    double cool = value<-half ? (-value-half)*scale*coolGain : 0;
+    Set(SSRPin, WindowOn(heat, windowSize), &ssrState, &ssrCycles);
+    Set(RelayPin, Relay(cool, coolWindowSize), &relayState, &relayCycles);
+  }
+
+  if(cyclesChanged && cycleOffset!=0 && millis()-cyclesSaved >= cycleSaveInterval)
+  {
+    EEPROM_writeAnything(cycleOffset, relayCycles);
+    EEPROM_writeAnything(cycleOffset+4, ssrCycles);
+    cyclesSaved = millis();
+    cyclesChanged = false;
+  }
+}
+
+void DigitalOutputCard::SerialSend()
+{
+  Serial.print((int)outputType);
+  Serial.print(' ');
+  PrintNumber(Serial, windowSec);
+  Serial.print(' ');
+  PrintNumber(Serial, coolWindowSec);
+  Serial.print(' ');
+  PrintNumber(Serial, deadband);
+  Serial.print(' ');
+  PrintNumber(Serial, heatGain);
+  Serial.print(' ');
+  PrintNumber(Serial, coolGain);
+  Serial.print(' ');
+  Serial.print((int)minOn);
+  Serial.print(' ');
+  Serial.print((int)minOff);
+  Serial.print(' ');
+  Serial.print(relayCycles);
+  Serial.print(' ');
+  Serial.print(ssrCycles);
+  Serial.println();
+}
@@ -0,0 +1,78 @@
+#ifndef DigitalOutputCard_h
+#define DigitalOutputCard_h
+
+#include "IOCard_local.h"
+
+/**********************************************************************************************
+ * Digital output cards V1.20 and V1.50: 1 SSR and 2 relay outputs (V1.50 only turns the LEDs
+ * around.)  the output is time proportioned over a window on either the relay or the SSR.
+ * see IOCard_local.h for the members every card has.
+ *
+ * split range (output type 2) is for processes that need cooling as well as heating:
+ * the controller's output goes from -100 to 100 (set it DIRECT), and above the deadband
+ * heats on the SSR while below it cools on the relay, each side scaled by its gain and
+ * time proportioned over its own window (the relay's is usually the longer.)  the
+ * deadband is centred on 0, in output %, and neither side is on inside it.
+ *
+ * the relay can be given minimum on and off times to keep it from wearing itself out on
+ * short pulses.  it then switches at most once each way per window: a pulse too short
+ * to allow is skipped and a gap too short to allow is filled, and the difference is
+ * carried into the following windows so the average stays right (see Relay().)  both
+ * pins count how many times they've switched on; the counts are saved hourly, so a power
+ * cut loses an hour's at most.
+ *
+ * eeprom: output type (0 relay, 1 SSR, 2 split range), the window in ms, then the cooling
+ * window in ms, deadband, heating gain, cooling gain, minimum on and off times (a byte
+ * each) and a spare byte.  the switching counts follow, outside the 24 bytes of settings.
+ * the config message from processing has the type and the window, optionally followed by
+ * the 4 split range settings (window in seconds) and then the 2 minimum times; one with
+ * any other type is ignored.  the line sent back has all of them, then the relay and SSR
+ * counts
+ **********************************************************************************************/
+class DigitalOutputCard
+{
+  public:
+    DigitalOutputCard();
+
+    void Initialize();
+    void Write(double);
+    void Disable();
+    void BackupParams(int);
+    void RestoreParams(int);
+    void SerialReceiveStart();
+    void SerialReceiveDuring(byte, byte);
+    void SerialReceiveAfter(int);
+    void SerialSend();
+    void SerialID();
+
+    void SetWindow(double);               // * seconds, 0.5 at least
+    void SetCoolWindow(double);           // * seconds, 0.5 at least
+    double OutputMin();                   // * what the controller's output can go down to
+
+    byte outputType;
+    double windowSec;                     // * what the lcd edits; SetWindow puts it to use
+    unsigned long windowSize;             // * ms
+    double coolWindowSec;                 // * split range only: the relay's window
+    unsigned long coolWindowSize;
+    float deadband;                       // * output %, 50 at most
+    float heatGain, coolGain;
+    byte minOn, minOff;                   // * relay, seconds.  0 for none.  half the window at most
+    unsigned long relayCycles, ssrCycles;
+
+  private:
+    byte Relay(double, unsigned long);
+    void Set(byte, byte, byte*, unsigned long*);
+
+    CardMessage<1,5> message;
+    byte received;                        // * how much of the message arrived
+    byte newMin[2];                       // * minimum times in the message
+
+    float relayDebt;                      // * ms of on time owed to the next window (- if ahead)
+    unsigned long relayStart, relayOnFor, relayLast;
+    byte relayState, ssrState;
+    int cycleOffset;                      // * where the counts live, 0 until it's known
+    unsigned long cyclesSaved;            // * millis() when they were last saved
+    bool cyclesChanged;
+};
+
+#endif
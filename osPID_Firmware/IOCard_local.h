@@ -0,0 +1,51 @@
+#ifndef IOCard_h
+#define IOCard_h
+
+#if ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+/**********************************************************************************************
+ * What an IO card class looks like
+ *
+ * io.h picks one input and one output card class at compile time and calls them directly,
+ * so there are no virtual functions and the calls can be inlined.  every card has:
+ *
+ *   void Initialize();                  * pins and such, from setup()
+ *   void BackupParams(int offset);      * its settings, laid out however it likes, at the
+ *   void RestoreParams(int offset);     *   eeprom offset the sketch gives it (20 bytes at most
+ *                                       *   for an input card, 40 for an output card.  the
+ *                                       *   config blob copies the first 20 or 24)
+ *   void SerialReceiveStart();          * a config message from processing arriving: before
+ *   void SerialReceiveDuring(byte, byte);*  the first byte, each byte and its index (1 is the
+ *   void SerialReceiveAfter(int offset);*   first after the identifier), then apply and back up
+ *   void SerialSend();                  * its settings, one line
+ *   void SerialID();                    * " IIDn" or " OIDn" for the info line
+ *
+ * and input cards:   double Read();     * the input, NAN when it can't be read
+ * or output cards:   void Write(double);* the output, OutputMin() to 100
+ *                    double OutputMin();* 0, or -100 when the output can cool as well as heat
+ *                    void Disable();    * safe state. called from the watchdog interrupt
+ *
+ * a card keeps the message it's receiving to itself (a CardMessage) so that cards don't
+ * share buffers with the sketch or each other.
+ **********************************************************************************************/
+
+// the bytes of a card's config message: nBytes single bytes, then nFloats floats
+template <byte nBytes, byte nFloats> struct CardMessage
+{
+  byte asBytes[nBytes];
+  float asFloat[nFloats];
+
+  void Receive(byte val, byte index)
+  {
+    if(index<1) return;
+    index--;
+    if(index<nBytes) asBytes[index] = val;
+    else if(index<nBytes+4*nFloats) ((byte*)asFloat)[index-nBytes] = val;
+  }
+};
+
+#endif
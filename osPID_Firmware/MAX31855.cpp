@@ -58,72 +58,72 @@ MAX31855::MAX31855(unsigned char SO, unsigned	char CS, unsigned char SCK)
 *******************************************************************************/	
 double	MAX31855::readThermocouple(unit_t	unit)
 {
-	unsigned long data;
+	int thermocouple, junction;
 	double temperature;
 	
-	// Initialize temperature
-	temperature = 0;
-	
-	// Shift in 32-bit of data from MAX31855
-	data = readData();
-	
-	// If fault is detected
-	if (data & 0x00010000)
+	switch (readCounts(&thermocouple, &junction))
 	{
-		// Check for fault type (3 LSB)
-		switch (data & 0x00000007)
-		{
-			// Open circuit 
-			case 0x01:
-				temperature = FAULT_OPEN;
-				break;
-			
-			// Thermocouple short to GND
-			case 0x02:
-				temperature = FAULT_SHORT_GND;
-				break;
-			
-			// Thermocouple short to VCC	
-			case 0x04:
-				temperature = FAULT_SHORT_VCC;
-				break;
-		}
+		// Open circuit 
+		case MAX31855_OPEN:
+			return FAULT_OPEN;
+		// Thermocouple short to GND
+		case MAX31855_SHORT_GND:
+			return FAULT_SHORT_GND;
+		// Thermocouple short to VCC	
+		case MAX31855_SHORT_VCC:
+			return FAULT_SHORT_VCC;
+		case MAX31855_OK:
+			break;
+		// More than one: the thermocouple is no use either way
+		default:
+			return FAULT_OPEN;
 	}
-	// No fault detected
-	else
+	
+	// Convert to Degree Celsius
+	temperature = thermocouple * 0.25;
+	
+	// If temperature unit in Fahrenheit is desired
+	if (unit == FAHRENHEIT)
 	{
-		// Retrieve thermocouple temperature data and strip redundant data
-		data = data >> 18;
-		// Bit-14 is the sign
-		temperature = (data & 0x00001FFF);
-
-		// Check for negative temperature		
-		if (data & 0x00002000)
-		{
-			// 2's complement operation
-			// Invert
-			data = ~data; 
-			// Ensure operation involves lower 13-bit only
-			temperature = data & 0x00001FFF;
-			// Add 1 to obtain the positive number
-			temperature += 1;
-			// Make temperature negative
-			temperature *= -1; 
-		}
-		
-		// Convert to Degree Celsius
-		temperature *= 0.25;
-		
-		// If temperature unit in Fahrenheit is desired
-		if (unit == FAHRENHEIT)
-		{
-			// Convert Degree Celsius to Fahrenheit
-			temperature = (temperature * 9.0/5.0)+ 32; 
-		}
+		// Convert Degree Celsius to Fahrenheit
+		temperature = (temperature * 9.0/5.0)+ 32; 
 	}
 	return (temperature);
 }
 
+/*******************************************************************************
+* Name: readCounts
+* Description: Read the thermocouple and cold junction temperatures from one
+*							 conversion, as the chip reports them: whole counts, with no
+*							 floating point.
+*
+* Argument  	Description
+* =========  	===========
+* 1. thermocouple	Thermocouple temperature in 0.25 Degree Celsius counts
+* 2. junction			Cold junction temperature in 0.0625 Degree Celsius counts
+*
+* Return			Description
+* =========		===========
+*	fault				MAX31855_OK, or the fault the chip found. the thermocouple
+*							count is meaningless when there's a fault.
+*******************************************************************************/	
+max31855Fault_t	MAX31855::readCounts(int *thermocouple, int *junction)
+{
+	unsigned long data;
+	
+	// Shift in 32-bit of data from MAX31855
+	data = readData();
+	
+	// 14-bit signed thermocouple count in the top bits, 12-bit signed junction
+	// count below the fault flag. shifting the signed 16-bit halves keeps the sign
+	*thermocouple = (int16_t)(data >> 16) >> 2;
+	*junction = (int16_t)(data & 0xFFFF) >> 4;
+	
+	// If fault is detected, the type is in the 3 LSB
+	if (data & 0x00010000) return (max31855Fault_t)(data & 0x00000007);
+	return MAX31855_OK;
+}
+
 /*******************************************************************************
 * Name: readJunction
 * Description: Read the thermocouple temperature either in Degree Celsius or
@@ -227,4 +227,157 @@ unsigned long MAX31855::readData()
 	digitalWrite(cs, HIGH);
 	
 	return(data);
-}
\ No newline at end of file
+}
+
+/*******************************************************************************
+* Linearization
+* each MAX31855 variant turns the thermocouple voltage into a temperature with
+* a single sensitivity, which is only right near the middle of the range (a
+* type-K variant reads 197.2 at 200 Degree Celsius.) the chip's sensitivity
+* gives the voltage back, the cold junction's own voltage is added, and the
+* NIST ITS-90 reference table for the type turns the total into the hot
+* junction temperature.  the tables are every 25 Degree Celsius from -200,
+* as steps in uV so they fit in 16 bits, and are interpolated in a straight
+* line: within 0.2 Degree Celsius of the reference from 0 up, 1 Degree Celsius
+* near -200 where the curves bend most.
+*******************************************************************************/
+// type K, -200 to 1350 C
+const unsigned int tcStepsK[] PROGMEM = {
+	437, 541, 637, 722, 799, 866, 921, 968, 1000, 1023,
+	1036, 1037, 1028, 1014, 1002, 998, 1003, 1012, 1023, 1033,
+	1039, 1045, 1050, 1054, 1058, 1061, 1063, 1065, 1066, 1066,
+	1066, 1063, 1062, 1058, 1054, 1050, 1045, 1039, 1034, 1028,
+	1022, 1016, 1010, 1003, 997, 991, 984, 978, 971, 964,
+	958, 950, 942, 934, 926, 917, 908, 898, 888, 878,
+	869, 859
+};
+
+// type J, -200 to 750 C
+const unsigned int tcStepsJ[] PROGMEM = {
+	626, 764, 883, 984, 1066, 1136, 1192, 1239, 1277, 1308,
+	1333, 1351, 1365, 1376, 1382, 1387, 1388, 1388, 1387, 1385,
+	1383, 1380, 1379, 1379, 1380, 1382, 1388, 1395, 1405, 1418,
+	1434, 1452, 1473, 1496, 1519, 1542, 1564, 1585
+};
+
+// type N, -200 to 1300 C
+const unsigned int tcStepsN[] PROGMEM = {
+	288, 366, 434, 495, 548, 590, 622, 647, 659, 681,
+	705, 729, 753, 775, 796, 815, 834, 850, 865, 879,
+	892, 903, 914, 924, 932, 940, 948, 954, 959, 965,
+	969, 972, 975, 978, 980, 981, 981, 983, 982, 982,
+	981, 980, 978, 977, 975, 973, 970, 967, 963, 960,
+	956, 952, 947, 942, 938, 932, 927, 921, 914, 905
+};
+
+// type T, -200 to 400 C
+const unsigned int tcStepsT[] PROGMEM = {
+	437, 518, 597, 672, 746, 814, 880, 939, 992, 1044,
+	1096, 1147, 1191, 1234, 1273, 1311, 1346, 1379, 1410, 1439,
+	1465, 1492, 1516, 1537
+};
+
+// type E, -200 to 1000 C
+const unsigned int tcStepsE[] PROGMEM = {
+	705, 841, 965, 1077, 1178, 1272, 1356, 1431, 1495, 1553,
+	1608, 1663, 1712, 1758, 1798, 1834, 1866, 1894, 1917, 1938,
+	1957, 1971, 1986, 1996, 2006, 2013, 2018, 2022, 2024, 2024,
+	2022, 2018, 2014, 2009, 2002, 1994, 1988, 1980, 1973, 1964,
+	1957, 1948, 1938, 1927, 1914, 1902, 1889, 1881
+};
+struct	tcTable_t
+{
+	const unsigned int *steps;
+	unsigned char n;			// steps in the table
+	long start;				// uV at -200 Degree Celsius
+	long sensitivity;		// nV per Degree Celsius the chip assumes
+};
+
+const tcTable_t tcTables[THERMOCOUPLE_TYPES] PROGMEM = {
+	{ tcStepsK, sizeof(tcStepsK)/sizeof(tcStepsK[0]), -5891, 41276 },
+	{ tcStepsJ, sizeof(tcStepsJ)/sizeof(tcStepsJ[0]), -7890, 57953 },
+	{ tcStepsN, sizeof(tcStepsN)/sizeof(tcStepsN[0]), -3990, 36256 },
+	{ tcStepsT, sizeof(tcStepsT)/sizeof(tcStepsT[0]), -5603, 52180 },
+	{ tcStepsE, sizeof(tcStepsE)/sizeof(tcStepsE[0]), -8825, 76373 }
+};
+
+#define	TC_TABLE_MIN	(-200*16)	// first entry, 0.0625 Degree Celsius counts
+#define	TC_TABLE_STEP	(25*16)		// between entries
+
+// Reference voltage (uV) at a temperature in 0.0625 Degree Celsius counts
+static bool	tcVoltage(const tcTable_t &table, long t, long *uv)
+{
+	long v = table.start;
+	long at = TC_TABLE_MIN;
+	for (unsigned char i = 0; i < table.n; i++)
+	{
+		long step = pgm_read_word(&table.steps[i]);
+		if (t <= at + TC_TABLE_STEP)
+		{
+			if (t < at) return false;
+			*uv = v + (step * (t - at) + TC_TABLE_STEP/2) / TC_TABLE_STEP;
+			return true;
+		}
+		v += step;
+		at += TC_TABLE_STEP;
+	}
+	return false;
+}
+
+// Temperature in 0.25 Degree Celsius counts for a reference voltage (uV).
+// the end segments reach 1 Degree Celsius past the table, so a reading right
+// at the limit isn't a fault just because the chip rounded it outwards
+static bool	tcTemperature(const tcTable_t &table, long uv, int *t)
+{
+	long v = table.start;
+	long at = TC_TABLE_MIN / 4;
+	for (unsigned char i = 0; i < table.n; i++)
+	{
+		long step = pgm_read_word(&table.steps[i]);
+		long slack = step / 25;
+		if (i == 0 && uv < v - slack) return false;
+		if (uv <= v + step || (i == table.n - 1 && uv <= v + step + slack))
+		{
+			*t = at + ((uv - v) * (TC_TABLE_STEP/4) + step/2) / step;
+			return true;
+		}
+		v += step;
+		at += TC_TABLE_STEP / 4;
+	}
+	return false;
+}
+
+/*******************************************************************************
+* Name: MAX31855Linearize
+* Description: Corrects a reading from readCounts for the thermocouple's
+*							 curve, with integer arithmetic only.
+*
+* Argument  	Description
+* =========  	===========
+* 1. type   		The MAX31855 variant
+* 2. thermocouple	Thermocouple count from readCounts
+* 3. junction		Cold junction count from readCounts
+* 4. celsius			Result, in 0.25 Degree Celsius counts
+*
+* Return			Description
+* =========		===========
+*	fault				MAX31855_OK, or MAX31855_RANGE when either junction is
+*							outside the type's table
+*******************************************************************************/
+max31855Fault_t	MAX31855Linearize(thermocouple_t type, int thermocouple,
+								  int junction, int *celsius)
+{
+	tcTable_t table;
+	long uv, junctionUv;
+	
+	if (type >= THERMOCOUPLE_TYPES) return MAX31855_RANGE;
+	memcpy_P(&table, &tcTables[type], sizeof(table));
+	
+	// Voltage the chip measured: the difference it reported, at its sensitivity
+	uv = ((long)thermocouple * 4 - junction) * table.sensitivity;
+	uv = (uv + (uv < 0 ? -8000 : 8000)) / 16000;
+	
+	if (!tcVoltage(table, junction, &junctionUv)) return MAX31855_RANGE;
+	if (!tcTemperature(table, uv + junctionUv, celsius)) return MAX31855_RANGE;
+	return MAX31855_OK;
+}
@@ -17,6 +17,28 @@ enum	unit_t
 	FAHRENHEIT
 };
 
+// Fault bits, as the chip reports them, plus one for a reading outside the
+// linearization tables
+enum	max31855Fault_t
+{
+	MAX31855_OK = 0,
+	MAX31855_OPEN = 1,
+	MAX31855_SHORT_GND = 2,
+	MAX31855_SHORT_VCC = 4,
+	MAX31855_RANGE = 8
+};
+
+// The MAX31855 variant fitted. each assumes its thermocouple is linear
+enum	thermocouple_t
+{
+	THERMOCOUPLE_K,
+	THERMOCOUPLE_J,
+	THERMOCOUPLE_N,
+	THERMOCOUPLE_T,
+	THERMOCOUPLE_E,
+	THERMOCOUPLE_TYPES
+};
+
 class	MAX31855
 {
 	public:
@@ -24,6 +46,7 @@ class	MAX31855
 	
 		double	readThermocouple(unit_t	unit);
 		double	readJunction(unit_t	unit);
+		max31855Fault_t	readCounts(int *thermocouple, int *junction);
 		
 	private:
 		unsigned char so;
@@ -33,4 +56,7 @@ class	MAX31855
 		unsigned long readData();
 
 };
+
+max31855Fault_t	MAX31855Linearize(thermocouple_t type, int thermocouple,
+								  int junction, int *celsius);
 #endif
\ No newline at end of file
@@ -0,0 +1,199 @@
+/**********************************************************************************************
+ * Modbus RTU slave for the osPID
+ *
+ * Just the part of the protocol a controller needs: reading holding and input registers,
+ * and writing holding registers one or several at a time.  what the registers mean is up
+ * to the sketch, through the two functions passed to the constructor.  requests sent to
+ * address 0 are broadcasts: writes are carried out but never answered.
+ *
+ * frames are delimited by silence on the line.  the port is polled from loop() rather
+ * than from the receive interrupt, so a gap can only be seen once loop() gets around to
+ * it; the 1.5 character limit inside a frame isn't checked for that reason, and the crc
+ * is what catches a damaged frame.
+ **********************************************************************************************/
+
+#if ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+#include "ModbusRtu_local.h"
+
+/* ModbusCrc(...) *************************************************************
+* CRC-16/MODBUS (polynomial 0xA001 reflected, starting from 0xFFFF.) sent
+* low byte first.  bit at a time: slower than a table, but no flash for one.
+* pass the last result as Crc to carry on over more bytes
+******************************************************************************/
+unsigned int ModbusCrc(const unsigned char* buf, unsigned char n, unsigned int Crc)
+{
+   unsigned int crc = Crc;
+   while(n--)
+   {
+      crc ^= *buf++;
+      for(unsigned char i=0;i<8;i++)
+      {
+         if(crc & 1) crc = (crc >> 1) ^ 0xA001;
+         else crc >>= 1;
+      }
+   }
+   return crc;
+}
+
+/*Constructor (...)*********************************************************
+* the quiet time that ends a frame is 3.5 characters (11 bits each with the
+* parity or second stop bit) below 19200 baud and a fixed 1.75ms above, as
+* the standard asks.  answers to address 1 until told otherwise.
+***************************************************************************/
+ModbusRtu::ModbusRtu(HardwareSerial* Port, unsigned long Baud, ModbusReadFn Read, ModbusWriteFn Write)
+{
+    port = Port;
+    readReg = Read;
+    writeReg = Write;
+    address = 1;
+    txEnable = 0xFF;
+    quietTime = Baud > 19200 ? 1750 : 38500000UL / Baud;
+    errors = 0;
+    lastByte = 0;
+    Flush();
+}
+
+/* Poll() *********************************************************************
+* takes whatever has arrived, then once nothing more has come for the quiet
+* time, treats what was collected as one frame.  a frame too long for the
+* buffer is thrown away whole.
+******************************************************************************/
+bool ModbusRtu::Poll()
+{
+   while(port->available())
+   {
+      unsigned char c = port->read();
+      if(len < MB_FRAME_SIZE) frame[len++] = c;
+      else overrun = true;
+      lastByte = micros();
+   }
+   if(len==0 || micros() - lastByte < quietTime) return false;
+   bool done = false;
+   if(overrun) errors++;
+   else done = Handle();
+   Flush();
+   return done;
+}
+
+void ModbusRtu::Flush()
+{
+   len = 0;
+   overrun = false;
+}
+
+/* Handle() *******************************************************************
+* checks the crc and the address, carries the request out and answers it.
+* the answer is built in the same buffer, over the request.
+******************************************************************************/
+bool ModbusRtu::Handle()
+{
+   if(len < 4) return false;
+   unsigned int crc = ModbusCrc(frame, len - 2);
+   if(frame[len-2] != (crc & 0xFF) || frame[len-1] != (crc >> 8))
+   {
+      errors++;
+      return false;
+   }
+   if(frame[0] != address && frame[0] != 0) return false;
+
+   unsigned char fn = frame[1];
+   unsigned int reg = (frame[2] << 8) | frame[3];
+   unsigned int count = (frame[4] << 8) | frame[5];
+   unsigned char code;
+   switch(fn)
+   {
+   case MB_READ_HOLDING:
+   case MB_READ_INPUT:
+      if(frame[0] == 0) return false; //nobody could answer a broadcast read
+      if(len != 8 || count < 1 || count > MB_MAX_REGS)
+      {
+         Exception(MB_ILLEGAL_VALUE);
+         break;
+      }
+      frame[2] = count * 2;
+      for(unsigned char i=0;i<count;i++)
+      {
+         unsigned int val;
+         code = readReg(fn, reg + i, &val);
+         if(code)
+         {
+            Exception(code);
+            return true;
+         }
+         frame[3 + 2*i] = val >> 8;
+         frame[4 + 2*i] = val & 0xFF;
+      }
+      Reply(3 + 2*count);
+      break;
+   case MB_WRITE_SINGLE:
+      if(len != 8) Exception(MB_ILLEGAL_VALUE);
+      else if((code = writeReg(reg, count))) Exception(code);
+      else Reply(6); //the request, echoed
+      break;
+   case MB_WRITE_MULTIPLE:
+      if(count < 1 || count > MB_MAX_REGS || frame[6] != count * 2 || len != 9 + count * 2)
+      {
+         Exception(MB_ILLEGAL_VALUE);
+         break;
+      }
+      for(unsigned char i=0;i<count;i++)
+      { //registers before a refused one stay written
+         code = writeReg(reg + i, (frame[7 + 2*i] << 8) | frame[8 + 2*i]);
+         if(code)
+         {
+            Exception(code);
+            return true;
+         }
+      }
+      Reply(6); //address, function, first register, count
+      break;
+   default:
+      Exception(MB_ILLEGAL_FUNCTION);
+      break;
+   }
+   return true;
+}
+
+void ModbusRtu::Exception(unsigned char code)
+{
+   frame[1] |= 0x80;
+   frame[2] = code;
+   Reply(3);
+}
+
+void ModbusRtu::Reply(unsigned char n)
+{
+   if(frame[0] == 0) return; //broadcasts aren't answered
+   unsigned int crc = ModbusCrc(frame, n);
+   frame[n] = crc & 0xFF;
+   frame[n+1] = crc >> 8;
+   if(txEnable != 0xFF)
+   {
+      digitalWrite(txEnable, HIGH);
+      delayMicroseconds(MB_TX_LEAD);
+   }
+   for(unsigned char i=0;i<n+2;i++) port->write(frame[i]);
+   if(txEnable != 0xFF)
+   {
+      port->flush(); //waits for the last stop bit before letting go of the line
+      digitalWrite(txEnable, LOW);
+   }
+}
+
+void ModbusRtu::SetAddress(unsigned char Address)
+{
+   if(Address >= 1 && Address <= 247) address = Address;
+}
+
+void ModbusRtu::SetTxEnable(unsigned char Pin)
+{
+   txEnable = Pin;
+}
+
+unsigned char ModbusRtu::GetAddress(){ return address; }
+unsigned int ModbusRtu::GetErrors(){ return errors; }
@@ -0,0 +1,69 @@
+#ifndef ModbusRtu_h
+#define ModbusRtu_h
+
+#define MB_FRAME_SIZE 40                  // longest frame handled, both ways
+#define MB_MAX_REGS 15                    // most registers in one read or write (fits the frame)
+#define MB_TX_LEAD 100                    // microseconds between enabling the driver and sending
+
+#define MB_READ_HOLDING 3                 // the function codes understood
+#define MB_READ_INPUT 4
+#define MB_WRITE_SINGLE 6
+#define MB_WRITE_MULTIPLE 16
+
+#define MB_ILLEGAL_FUNCTION 1             // exception codes
+#define MB_ILLEGAL_ADDRESS 2
+#define MB_ILLEGAL_VALUE 3
+#define MB_DEVICE_FAILURE 4
+
+typedef unsigned char (*ModbusReadFn)(unsigned char table,     // MB_READ_HOLDING or MB_READ_INPUT
+                                      unsigned int reg,        // register number (0 based)
+                                      unsigned int* val);      // returns 0 or an exception code
+typedef unsigned char (*ModbusWriteFn)(unsigned int reg,        // holding register number
+                                       unsigned int val);       // returns 0 or an exception code
+
+class ModbusRtu
+{
+
+
+  public:
+
+  //commonly used functions **************************************************************************
+    ModbusRtu(HardwareSerial*,            // * constructor.  links the slave to a serial port that's
+              unsigned long,              //   already running at this baud rate, and to the functions
+              ModbusReadFn, ModbusWriteFn);//  that look up and change registers
+
+    bool Poll();                          // * collects request bytes and answers a request once the
+                                          //   line has been quiet for 3.5 characters. call it every
+                                          //   loop. returns true when a request for us was carried out
+
+    void SetAddress(unsigned char);       // * slave address, 1-247
+
+    void SetTxEnable(unsigned char);      // * pin that enables an RS-485 driver while answering
+
+    void Flush();                         // * drops whatever has been collected so far
+
+  //Display functions ****************************************************************
+    unsigned char GetAddress();
+    unsigned int GetErrors();             // * frames dropped for a bad crc or for being too long
+
+  private:
+    bool Handle();
+    void Reply(unsigned char);
+    void Exception(unsigned char);
+
+    HardwareSerial *port;
+    ModbusReadFn readReg;
+    ModbusWriteFn writeReg;
+    unsigned char address;
+    unsigned char txEnable;               // * 0xFF when there's no driver to enable
+    unsigned char frame[MB_FRAME_SIZE];
+    unsigned char len;
+    bool overrun;
+    unsigned int errors;
+    unsigned long quietTime;              // * 3.5 characters, in microseconds
+    unsigned long lastByte;
+};
+
+unsigned int ModbusCrc(const unsigned char*, unsigned char, // * crc of a buffer, or carried on from
+                       unsigned int Crc = 0xFFFF);         //   an earlier one
+#endif
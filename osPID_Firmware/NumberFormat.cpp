@@ -0,0 +1,84 @@
+/**********************************************************************************************
+ * Number formatting for the osPID
+ *
+ * The lcd and the serial telemetry both show fixed point numbers. printing a float
+ * the stock way costs a float multiply, subtract and cast per digit; here the value
+ * is scaled and rounded once, and the digits come out of integer division. NAN and
+ * anything too big for the field show up as "Error" everywhere (Serial.print
+ * sent "nan", "inf" or "ovf"; see README.txt for what that means to Processing.)
+ **********************************************************************************************/
+
+#if ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+#include "NumberFormat_local.h"
+
+static const float scales[NUMBER_MAX_DEC+1] = {1, 10, 100, 1000, 10000};
+
+/* FormatNumber(...)***********************************************************
+* digits are generated backwards into a scratch buffer, then copied out behind
+* any padding. the scaled value has to fit in a long, which is plenty for a
+* temperature controller (+-21 million at 2 decimals.)
+******************************************************************************/
+byte FormatNumber(char *buf, double val, byte dec, byte width)
+{
+  char tmp[NUMBER_BUFFER];
+  byte n = 0;
+  if(dec > NUMBER_MAX_DEC) dec = NUMBER_MAX_DEC;
+
+  bool ok = !isnan(val);
+  if(ok)
+  {
+    double scaled = val * scales[dec];
+    bool neg = scaled < 0;
+    if(neg) scaled = -scaled;
+    ok = scaled < 2147483647.0;
+    if(ok)
+    {
+      unsigned long num = (unsigned long)(scaled + 0.5);
+      if(num == 0) neg = false; //no "-0.0"
+      for(byte i=0;i<dec;i++)
+      {
+        tmp[n++] = '0' + num % 10;
+        num /= 10;
+      }
+      if(dec) tmp[n++] = '.';
+      //most numbers fit in 16 bits, where the division is a lot cheaper
+      while(num > 0xFFFF)
+      {
+        tmp[n++] = '0' + num % 10;
+        num /= 10;
+      }
+      unsigned int small = num;
+      do
+      {
+        tmp[n++] = '0' + small % 10;
+        small /= 10;
+      } while(small);
+      if(neg) tmp[n++] = '-';
+      ok = width == 0 || n <= width;
+    }
+  }
+
+  byte len = 0;
+  if(!ok)
+  {
+    n = 0;
+    const char *err = "rorrE"; //backwards, like the digits
+    while(err[n]) { tmp[n] = err[n]; n++; }
+  }
+  while(len + n < width) buf[len++] = ' ';
+  while(n) buf[len++] = tmp[--n];
+  buf[len] = 0;
+  return ok ? len : 0;
+}
+
+void PrintNumber(Print &out, double val, byte dec)
+{
+  char buf[NUMBER_BUFFER];
+  FormatNumber(buf, val, dec, 0);
+  out.print(buf);
+}
@@ -0,0 +1,21 @@
+#ifndef NumberFormat_h
+#define NumberFormat_h
+
+#if ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+#define NUMBER_MAX_DEC 4                  // most decimals FormatNumber will do
+#define NUMBER_BUFFER 14                  // big enough for any result, NUL included
+
+byte FormatNumber(char*, double,          // * writes the value into the buffer with the given number
+                  byte, byte);            //   of decimals, right aligned in width characters (0 for
+                                          //   no padding.)  returns the length, or 0 and "Error" if
+                                          //   the value is NAN or won't fit
+
+void PrintNumber(Print&, double,          // * FormatNumber straight to the lcd or serial port.
+                 byte dec = 2);           //   2 decimals, like Serial.print(double)
+
+#endif
@@ -0,0 +1,160 @@
+/**********************************************************************************************
+ * Online model identification for the osPID
+ *
+ * Fits a first order plus dead time model to the input and output while the loop
+ * runs, with recursive least squares, so tunings can be worked out without taking the
+ * loop out of automatic for a relay test.  the fit is only as good as the data: the
+ * process has to move (setpoint changes, disturbances) before the model means anything,
+ * which is what the confidence figure tracks.
+ **********************************************************************************************/
+
+#if ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+#include "OnlineTune_local.h"
+
+/*Constructor (...)*********************************************************
+* 1 second samples, no dead time and a forgetting factor of 0.99 (a memory
+* of about 100 samples) until configured.
+***************************************************************************/
+OnlineTune::OnlineTune(double* Input, double* Output)
+{
+    myInput = Input;
+    myOutput = Output;
+    sampleTime = 1000;
+    delaySteps = 0;
+    lambda = 0.99;
+    Reset();
+}
+
+/* Compute() ******************************************************************
+* One step of recursive least squares on y(k) = a*y(k-1) + b*u(k-1-d) + c.
+* the prediction error is taken before the update, so it's an honest measure
+* of how well the model predicts.
+******************************************************************************/
+bool OnlineTune::Compute()
+{
+   unsigned long now = millis();
+   if(now - lastTime < sampleTime) return false;
+   lastTime = now;
+   float y = *myInput, u = *myOutput;
+   if(isnan(y)) return false;
+   if(!primed)
+   {
+      y0 = y;
+      u0 = u;
+      yPrev = 0;
+      for(unsigned char i=0;i<=delaySteps;i++) uHistory[i] = 0;
+      head = 0;
+      primed = true;
+      return true;
+   }
+   y -= y0;
+   u -= u0;
+   float phi[3] = {yPrev, uHistory[head], 1};
+   uHistory[head] = u;
+   if(++head > delaySteps) head = 0;
+
+   float e = y;
+   float Pphi[3];
+   float denom = lambda;
+   for(unsigned char i=0;i<3;i++)
+   {
+      e -= theta[i] * phi[i];
+      Pphi[i] = P[i][0]*phi[0] + P[i][1]*phi[1] + P[i][2]*phi[2];
+      denom += phi[i] * Pphi[i];
+   }
+   for(unsigned char i=0;i<3;i++)
+   {
+      float k = Pphi[i] / denom;
+      theta[i] += k * e;
+      for(unsigned char j=0;j<3;j++) P[i][j] -= k * Pphi[j]; //P is symmetric, so phi'P = Pphi'
+   }
+   //without fresh excitation P grows every step; stop forgetting before it blows up
+   if(P[0][0] + P[1][1] + P[2][2] < 10000)
+   {
+      for(unsigned char i=0;i<3;i++) for(unsigned char j=0;j<3;j++) P[i][j] /= lambda;
+   }
+
+   float dy = y - yPrev;
+   errVar = lambda * errVar + (1 - lambda) * e * e;
+   diffVar = lambda * diffVar + (1 - lambda) * dy * dy;
+   yPrev = y;
+   if(count < 0xFFFF) count++;
+   return true;
+}
+
+/* Reset() ********************************************************************
+* The model starts as "nothing changes" with a large covariance, so the first
+* samples move it quickly.
+******************************************************************************/
+void OnlineTune::Reset()
+{
+   for(unsigned char i=0;i<3;i++)
+   {
+      theta[i] = 0;
+      for(unsigned char j=0;j<3;j++) P[i][j] = (i==j) ? 1000 : 0;
+   }
+   theta[0] = 1;
+   errVar = 0;
+   diffVar = 0;
+   count = 0;
+   primed = false;
+   lastTime = millis() - sampleTime;
+}
+
+void OnlineTune::SetSampleTime(double Sec)
+{
+   if(!(Sec > 0)) return;
+   sampleTime = (unsigned long)(Sec * 1000);
+   Reset();
+}
+
+void OnlineTune::SetDeadTime(double Sec)
+{
+   if(!(Sec >= 0)) return;
+   double steps = Sec * 1000 / sampleTime + 0.5;
+   delaySteps = steps > OT_DELAY_STEPS ? OT_DELAY_STEPS : (unsigned char)steps;
+   Reset();
+}
+
+void OnlineTune::SetForgetting(double Lambda)
+{
+   if(Lambda < 0.9 || Lambda > 1) return;
+   lambda = Lambda;
+}
+
+/* Status Functions *******************************************************
+* The model is only usable once it has seen a few memory lengths' worth of
+* samples and describes a stable, non-integrating process (0 < a < 1.)
+******************************************************************************/
+bool OnlineTune::IsValid()
+{
+   return count >= 30 && theta[0] > 0 && theta[0] < 1 && theta[1] != 0;
+}
+
+double OnlineTune::GetGain()
+{
+   return theta[1] / (1 - theta[0]);
+}
+
+double OnlineTune::GetTimeConstant()
+{
+   if(!(theta[0] > 0 && theta[0] < 1)) return 0;
+   return -((double)sampleTime / 1000) / log(theta[0]);
+}
+
+double OnlineTune::GetDeadTime()
+{
+   return (double)delaySteps * sampleTime / 1000;
+}
+
+double OnlineTune::GetConfidence()
+{
+   if(count < 30 || !(diffVar > 0)) return 0;
+   double c = 1 - errVar / diffVar;
+   return c < 0 ? 0 : c;
+}
@@ -0,0 +1,51 @@
+#ifndef OnlineTune_h
+#define OnlineTune_h
+
+#define OT_DELAY_STEPS 12                 // longest dead time, in model samples
+
+class OnlineTune
+{
+
+
+  public:
+
+  //commonly used functions **************************************************************************
+    OnlineTune(double*, double*);         // * constructor.  links the identifier to the measured
+                                          //   Input and the Output actually applied
+
+    bool Compute();                       // * takes a sample once per sample time and updates the
+                                          //   model.  returns true when it did
+
+    void Reset();                         // * forgets the model and starts identifying again
+
+    void SetSampleTime(double);           // * model sample time (sec.) resets the model
+
+    void SetDeadTime(double);             // * known dead time (sec,) rounded to whole samples.
+                                          //   resets the model
+
+    void SetForgetting(double);           // * 0.9-1.  lower follows changes faster but is noisier
+
+  //Display functions ****************************************************************
+    bool IsValid();                       // * the model is stable and confident enough to tune from
+    double GetGain();
+    double GetTimeConstant();
+    double GetDeadTime();
+    double GetConfidence();               // * 0-1.  how much better the model predicts the next
+                                          //   input than "no change" does
+
+  private:
+    double *myInput;
+    double *myOutput;
+
+    float theta[3];                       // * model: y = theta0*y' + theta1*u(delayed) + theta2
+    float P[3][3];                        // * parameter covariance
+    float lambda;
+    float errVar, diffVar;                // * filtered prediction error and input change, squared
+    float y0, u0, yPrev;                  // * samples are taken relative to the first one
+    float uHistory[OT_DELAY_STEPS+1];     // * circular buffer of past outputs (head is the oldest)
+    unsigned char head, delaySteps;
+    unsigned int count;
+    bool primed;
+    unsigned long sampleTime, lastTime;
+};
+#endif
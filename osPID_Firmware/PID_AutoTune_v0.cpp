@@ -58,6 +58,12 @@ void PID_ATune::Cancel()
 {
 	running = false;
 } 
+
+uint8_t* PID_ATune::Scratch(int size)
+{
+	if(running || size > (int)sizeof(history)) return 0;
+	return (uint8_t*)&history;
+}
  
 int PID_ATune::Runtime()
 {
@@ -86,6 +92,7 @@ int PID_ATune::Runtime()
 		initCount=0;
 		outputStart = *output;
 		*output = outputStart+oStep;
+		memset(&history, 0, sizeof(history)); //it may have been lent out
 	}
 	else
 	{
@@ -101,15 +108,17 @@ int PID_ATune::Runtime()
 	
   //bool isMax=true, isMin=true;
   isMax=true;isMin=true;
-  //id peaks
+  //id peaks.  the history is kept as 1/64ths relative to the
+  //setpoint (see CompactInput) to save RAM
+  int refCompact = CompactInput(refVal);
   for(int i=nLookBack-1;i>=0;i--)
   {
-    double val = lastInputs[i];
-    if(isMax) isMax = refVal>val;
-    if(isMin) isMin = refVal<val;
-    lastInputs[i+1] = lastInputs[i];
+    int val = history.lastInputs[i];
+    if(isMax) isMax = refCompact>val;
+    if(isMin) isMin = refCompact<val;
+    history.lastInputs[i+1] = history.lastInputs[i];
   }
-  lastInputs[0] = refVal;  
+  history.lastInputs[0] = refCompact;  
   if(nLookBack<9)
   {  //we don't want to trust the maxes or mins until the inputs array has been filled
 	initCount++;
@@ -126,7 +135,7 @@ int PID_ATune::Runtime()
       peak2 = peak1;
     }
     peak1 = now;
-    peaks[peakCount] = refVal;
+    history.peaks[peakCount] = refVal;
    
   }
   else if(isMin)
@@ -139,12 +148,12 @@ int PID_ATune::Runtime()
       justchanged=true;
     }
     
-    if(peakCount<10)peaks[peakCount] = refVal;
+    if(peakCount<10)history.peaks[peakCount] = refVal;
   }
   
   if(justchanged && peakCount>2)
   { //we've transitioned.  check if we can autotune based on the last peaks
-    double avgSeparation = (abs(peaks[peakCount-1]-peaks[peakCount-2])+abs(peaks[peakCount-2]-peaks[peakCount-3]))/2;
+    double avgSeparation = (abs(history.peaks[peakCount-1]-history.peaks[peakCount-2])+abs(history.peaks[peakCount-2]-history.peaks[peakCount-3]))/2;
     if( avgSeparation < 0.05*(absMax-absMin))
     {
 		FinishUp();
@@ -156,6 +165,19 @@ int PID_ATune::Runtime()
    justchanged=false;
 	return 0;
 }
+/* CompactInput(...)
+ * an input sample as a 16 bit count of 1/64ths away from the setpoint,
+ * clipped at +/-511.  that's plenty to find peaks with and takes half
+ * the space of a double
+ */
+int PID_ATune::CompactInput(double val)
+{
+	double scaled = (val - setpoint) * 64;
+	if(scaled > 32767) return 32767;
+	if(scaled < -32767) return -32767;
+	return (int)scaled;
+}
+
 void PID_ATune::FinishUp()
 {
 	  *output = outputStart;
@@ -179,6 +201,16 @@ double PID_ATune::GetKd()
 	return controlType==1? 0.075 * Ku * Pu : 0;  //Kd = Kc * Td
 }
 
+double PID_ATune::GetKu()
+{
+	return Ku;
+}
+
+double PID_ATune::GetPu()
+{
+	return Pu;
+}
+
 void PID_ATune::SetOutputStep(double Step)
 {
 	oStep = Step;
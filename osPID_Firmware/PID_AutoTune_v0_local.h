@@ -1,5 +1,6 @@
 #ifndef PID_AutoTune_v0
 #define PID_AutoTune_v0
+#undef LIBRARY_VERSION //PID_v1 has one too
 #define LIBRARY_VERSION	0.0.0
 
 class PID_ATune
@@ -27,9 +28,17 @@ class PID_ATune
 	double GetKp();										// * once autotune is complete, these functions contain the
 	double GetKi();										//   computed tuning parameters.  
 	double GetKd();										//
+
+	double GetKu();										// * the ultimate gain and period (sec) the
+	double GetPu();										//   tunings were worked out from
+
+	uint8_t* Scratch(int);								// * lends out the input and peak history as that
+														//   many bytes of buffer (0 if it's running, or too
+														//   small.)  the next run starts it afresh
 	
   private:
     void FinishUp();
+	int CompactInput(double);
 	bool isMax, isMin;
 	double *input, *output;
 	double setpoint;
@@ -40,8 +49,11 @@ class PID_ATune
 	int sampleTime;
 	int nLookBack;
 	int peakType;
-	double lastInputs[100];
-    double peaks[10];
+	struct
+	{
+		int lastInputs[101];							// * one more than the longest lookback, room to shift into
+		double peaks[10];
+	} history;											// * together, so Scratch has one piece to lend
 	int peakCount;
 	bool justchanged;
 	bool justevaled;
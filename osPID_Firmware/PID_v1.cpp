@@ -20,16 +20,24 @@
 PID::PID(double* Input, double* Output, double* Setpoint,
         double Kp, double Ki, double Kd, int ControllerDirection)
 {
+    inAuto = false;
 PID::SetOutputLimits(0, 255); //default output limit corresponds to
 //the arduino pwm limits
 
     SampleTime = 100; //default Controller Sample Time is 0.1 seconds
+    antiWindup = AW_CLAMP;
+    kt = 0;
+    lastPD = 0;
+    filterN = 0;
+    dAlpha = 0;
+    dTerm = 0;
+    bWeight = 1;
+    cWeight = 0;
 
     PID::SetControllerDirection(ControllerDirection);
     PID::SetTunings(Kp, Ki, Kd);
 
     lastTime = millis()-SampleTime;
-    inAuto = false;
     myOutput = Output;
     myInput = Input;
     mySetpoint = Setpoint;
@@ -51,21 +59,48 @@ void PID::Compute()
    {
       /*Compute all the working error variables*/
       double input = *myInput;
-      double error = *mySetpoint - input;
-      ITerm+= (ki * error);
+      double sp = *mySetpoint;
+      double error = sp - input;
+      double dInput = (input - lastInput);
+      double dSetpoint = (sp - lastSetpoint);
+
+      /*Setpoint weighting: a setpoint change only moves the P term by
+        b times the change (the rest is taken up by the integral) and the
+        D term by c times the change, so steps don't kick the output*/
+      ITerm -= (1 - bWeight) * kp * dSetpoint;
+
+      /*the derivative is low-pass filtered so noise isn't amplified*/
+      double dRaw = kd * (cWeight * dSetpoint - dInput);
+      dTerm = dAlpha * dTerm + (1 - dAlpha) * dRaw;
+      double pd = kp * error + dTerm;
+      double iStep = ki * error;
+
+      /*Conditional integration: hold the integral if the output is
+        saturated and this step would only push it further into the limit*/
+      if(antiWindup == AW_CONDITIONAL)
+      {
+         double trial = pd + ITerm + iStep;
+         if((trial > outMax && iStep > 0) || (trial < outMin && iStep < 0)) iStep = 0;
+      }
+      ITerm+= iStep;
       if(ITerm > outMax) ITerm= outMax;
       else if(ITerm < outMin) ITerm= outMin;
-      double dInput = (input - lastInput);
  
       /*Compute PID Output*/
-      double output = kp * error + ITerm- kd * dInput;
-      
-      if(output > outMax) output = outMax;
-      else if(output < outMin) output = outMin;
-      *myOutput = output;
+      double output = pd + ITerm;
+      double limited = output;
+      if(limited > outMax) limited = outMax;
+      else if(limited < outMin) limited = outMin;
+
+      /*Back-calculation: bleed the part of the output that the limits
+        cut off back out of the integral*/
+      if(antiWindup == AW_BACKCALC) ITerm += kt * (limited - output);
+      *myOutput = limited;
 
       /*Remember some variables for next time*/
+      lastPD = pd;
       lastInput = input;
+      lastSetpoint = sp;
       lastTime = now;
    }
 }
@@ -74,7 +109,9 @@ void PID::Compute()
 /* SetTunings(...)*************************************************************
 * This function allows the controller's dynamic performance to be adjusted.
 * it's called automatically from the constructor, but tunings can also
-* be adjusted on the fly during normal operation
+* be adjusted on the fly during normal operation. when that happens in
+* automatic, the integral takes up the change in the proportional term so
+* the output doesn't bump (gain scheduling relies on this.)
 ******************************************************************************/
 void PID::SetTunings(double Kp, double Ki, double Kd)
 {
@@ -83,6 +120,7 @@ void PID::SetTunings(double Kp, double Ki, double Kd)
    dispKp = Kp; dispKi = Ki; dispKd = Kd;
    
    double SampleTimeInSec = ((double)SampleTime)/1000;
+   double oldKp = kp;
    kp = Kp;
    ki = Ki * SampleTimeInSec;
    kd = Kd / SampleTimeInSec;
@@ -93,6 +131,13 @@ void PID::SetTunings(double Kp, double Ki, double Kd)
       ki = (0 - ki);
       kd = (0 - kd);
    }
+   if(inAuto)
+   {
+      ITerm += (oldKp - kp) * (*mySetpoint - *myInput);
+      if(ITerm > outMax) ITerm= outMax;
+      else if(ITerm < outMin) ITerm= outMin;
+   }
+   UpdateFilter();
 }
   
 /* SetSampleTime(...) *********************************************************
@@ -107,7 +152,78 @@ void PID::SetSampleTime(int NewSampleTime)
       ki *= ratio;
       kd /= ratio;
       SampleTime = (unsigned long)NewSampleTime;
+      UpdateFilter();
+   }
+}
+ 
+/* SetAntiWindup(...)*********************************************************
+* AW_CLAMP just limits the integral to the output range. AW_BACKCALC also
+* feeds the amount the output was limited by back into the integral, scaled by
+* TrackingGain (0-1, fraction per sample.) AW_CONDITIONAL stops integrating
+* whenever the output is saturated in the direction the error is pushing.
+******************************************************************************/
+void PID::SetAntiWindup(int Mode, double TrackingGain)
+{
+   if(Mode < AW_CLAMP || Mode > AW_CONDITIONAL) return;
+   if(TrackingGain < 0) TrackingGain = 0;
+   else if(TrackingGain > 1) TrackingGain = 1;
+   antiWindup = Mode;
+   kt = TrackingGain;
+}
+
+/* SetDerivativeFilter(...)***************************************************
+* The derivative is passed through a first order filter with a time constant
+* of Td/N (Td = Kd/Kp.) typical values of N are 2-20; smaller is smoother.
+* 0 disables the filter.
+******************************************************************************/
+void PID::SetDerivativeFilter(double N)
+{
+   if(N < 0) return;
+   filterN = N;
+   UpdateFilter();
+}
+
+/* SetSetpointWeights(...)****************************************************
+* B is the fraction of a setpoint change passed on by the proportional term
+* and C the fraction passed on by the derivative term. the integral always
+* sees the full error, so the setpoint is still reached. lowering B softens
+* the response to setpoint steps without slowing disturbance rejection.
+******************************************************************************/
+void PID::SetSetpointWeights(double B, double C)
+{
+   if(B < 0 || B > 1 || C < 0 || C > 1) return;
+   bWeight = B;
+   cWeight = C;
+}
+
+/* UpdateFilter()**************************************************************
+* works out the per-sample derivative smoothing coefficient. called whenever
+* the tunings, sample time or N change.
+******************************************************************************/
+void PID::UpdateFilter()
+{
+   if(filterN <= 0 || dispKp <= 0 || dispKd <= 0)
+   {
+      dAlpha = 0;
+      return;
    }
+   double Tf = dispKd / (dispKp * filterN);
+   double SampleTimeInSec = ((double)SampleTime)/1000;
+   dAlpha = Tf / (Tf + SampleTimeInSec);
+}
+
+/* Track(...)******************************************************************
+* When the output is overridden from outside (a fail-safe zeroing it, for
+* instance,) the integral is back-calculated so that the controller output
+* equals the applied value. once the override ends, Compute continues from
+* there instead of from a stale integral.
+******************************************************************************/
+void PID::Track(double Value)
+{
+   if(!inAuto) return;
+   ITerm = Value - lastPD;
+   if(ITerm > outMax) ITerm= outMax;
+   else if(ITerm < outMin) ITerm= outMin;
 }
  
 /* SetOutputLimits(...)****************************************************
@@ -157,6 +273,9 @@ void PID::Initialize()
 {
    ITerm = *myOutput;
    lastInput = *myInput;
+   lastSetpoint = *mySetpoint;
+   lastPD = 0;
+   dTerm = 0;
    if(ITerm > outMax) ITerm = outMax;
    else if(ITerm < outMin) ITerm = outMin;
 }
@@ -188,5 +307,9 @@ double PID::GetKi(){ return dispKi;}
 double PID::GetKd(){ return dispKd;}
 int PID::GetMode(){ return inAuto ? AUTOMATIC : MANUAL;}
 int PID::GetDirection(){ return controllerDirection;}
+int PID::GetAntiWindup(){ return antiWindup;}
+double PID::GetDerivativeFilter(){ return filterN;}
+double PID::GetSetpointWeightP(){ return bWeight;}
+double PID::GetSetpointWeightD(){ return cWeight;}
 
 
@@ -13,6 +13,9 @@ class PID
   #define MANUAL	0
   #define DIRECT  0
   #define REVERSE  1
+  #define AW_CLAMP	0
+  #define AW_BACKCALC	1
+  #define AW_CONDITIONAL	2
 
   //commonly used functions **************************************************************************
     PID(double*, double*, double*,        // * constructor.  links the PID to the Input, Output, and 
@@ -41,6 +44,21 @@ class PID
 										  //   once it is set in the constructor.
     void SetSampleTime(int);              // * sets the frequency, in Milliseconds, with which 
                                           //   the PID calculation is performed.  default is 100
+
+    void SetAntiWindup(int, double);      // * selects how the integral is kept from winding up while
+                                          //   the output is saturated: AW_CLAMP (default), AW_BACKCALC
+                                          //   (with a 0-1 tracking gain) or AW_CONDITIONAL
+
+    void SetDerivativeFilter(double);     // * first order filter on the derivative term. the filter time
+                                          //   constant is Td/N, with Td = Kd/Kp.  0 turns it off
+
+    void SetSetpointWeights(double,       // * 2-DOF setpoint weighting.  fraction of a setpoint change
+                            double);      //   seen by the P (b) and D (c) terms.  b=1, c=0 is a plain
+                                          //   PID with derivative on measurement
+
+    void Track(double);                   // * tells the PID what output was actually applied when
+                                          //   something else forced it (e.g. a fail-safe.) the integral
+                                          //   follows so the next Compute picks up from there
 										  
 										  
 										  
@@ -50,9 +68,14 @@ class PID
 	double GetKd();						  // where it's important to know what is actually 
 	int GetMode();						  //  inside the PID.
 	int GetDirection();					  //
+	int GetAntiWindup();				  //
+	double GetDerivativeFilter();		  //
+	double GetSetpointWeightP();		  //
+	double GetSetpointWeightD();		  //
 
   private:
 	void Initialize();
+	void UpdateFilter();
 	
 	double dispKp;				// * we'll hold on to the tuning parameters in user-entered 
 	double dispKi;				//   format for display purposes
@@ -71,6 +94,16 @@ class PID
 			  
 	unsigned long lastTime;
 	double ITerm, lastInput;
+	double lastPD;				// * proportional and derivative contribution from the last Compute
+
+	double filterN;				// * derivative filter factor and the per-sample
+	double dAlpha;				//   smoothing coefficient it works out to
+	double dTerm;				// * filtered derivative contribution
+	double bWeight, cWeight;	// * setpoint weights for P and D
+	double lastSetpoint;
+
+	int antiWindup;
+	double kt;					// * back-calculation tracking gain
 
 	int SampleTime;
 	double outMin, outMax;
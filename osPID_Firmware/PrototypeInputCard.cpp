@@ -0,0 +1,75 @@
+#include "PrototypeInputCard_local.h"
+#include "EEPROMAnything.h"
+#include "NumberFormat_local.h"
+
+ /*Include any libraries and/or global variables here*/
+
+PrototypeInputCard::PrototypeInputCard()
+{
+  for(byte i=0;i<4;i++)
+  {
+    bt[i] = 0;
+    flt[i] = 0;
+  }
+}
+
+void PrototypeInputCard::Initialize()
+{
+}
+
+void PrototypeInputCard::BackupParams(int offset)
+{
+  for(byte i=0;i<4;i++) EEPROM.write(offset+i, bt[i]);
+  for(byte i=0;i<4;i++) EEPROM_writeAnything(offset+4+4*i, flt[i]);
+}
+
+void PrototypeInputCard::RestoreParams(int offset)
+{
+  for(byte i=0;i<4;i++) bt[i] = EEPROM.read(offset+i);
+  for(byte i=0;i<4;i++) EEPROM_readAnything(offset+4+4*i, flt[i]);
+}
+
+void PrototypeInputCard::SerialReceiveStart()
+{
+}
+
+void PrototypeInputCard::SerialReceiveDuring(byte val, byte index)
+{
+  message.Receive(val, index);
+}
+
+void PrototypeInputCard::SerialReceiveAfter(int offset)
+{
+  for(byte i=0;i<4;i++)
+  {
+    bt[i] = message.asBytes[i];
+    flt[i] = message.asFloat[i];
+  }
+  BackupParams(offset);
+}
+
+void PrototypeInputCard::SerialSend()
+{
+  for(byte i=0;i<4;i++)
+  {
+    Serial.print(int(bt[i]));
+    Serial.print(' ');
+  }
+  for(byte i=0;i<4;i++)
+  {
+    if(i) Serial.print(' ');
+    PrintNumber(Serial, flt[i]);
+  }
+  Serial.println();
+}
+
+void PrototypeInputCard::SerialID()
+{
+  Serial.print(F(" IID0"));
+}
+
+double PrototypeInputCard::Read()
+{
+  /*your code here*/
+  return 0;
+}
@@ -0,0 +1,34 @@
+#ifndef PrototypeInputCard_h
+#define PrototypeInputCard_h
+
+#include "IOCard_local.h"
+
+/**********************************************************************************************
+ * Generic prototype input card, with the input specified by the user: add whatever it
+ * needs to PrototypeInputCard.cpp.  4 bytes and 4 floats of settings are kept in the
+ * eeprom and exchanged with processing for it to use.  see IOCard_local.h for the members
+ * every card has.
+ **********************************************************************************************/
+class PrototypeInputCard
+{
+  public:
+    PrototypeInputCard();
+
+    void Initialize();
+    double Read();
+    void BackupParams(int);
+    void RestoreParams(int);
+    void SerialReceiveStart();
+    void SerialReceiveDuring(byte, byte);
+    void SerialReceiveAfter(int);
+    void SerialSend();
+    void SerialID();
+
+    byte bt[4];
+    float flt[4];
+
+  private:
+    CardMessage<4,4> message;
+};
+
+#endif
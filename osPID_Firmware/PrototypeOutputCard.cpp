@@ -0,0 +1,86 @@
+#include "PrototypeOutputCard_local.h"
+#include "EEPROMAnything.h"
+#include "NumberFormat_local.h"
+
+ /*Include any libraries and/or global variables here*/
+
+PrototypeOutputCard::PrototypeOutputCard()
+{
+  for(byte i=0;i<4;i++)
+  {
+    bt[i] = 0;
+    flt[i] = 0;
+  }
+}
+
+void PrototypeOutputCard::Initialize()
+{
+}
+
+void PrototypeOutputCard::BackupParams(int offset)
+{
+  for(byte i=0;i<4;i++) EEPROM.write(offset+i, bt[i]);
+  for(byte i=0;i<4;i++) EEPROM_writeAnything(offset+4+4*i, flt[i]);
+}
+
+void PrototypeOutputCard::RestoreParams(int offset)
+{
+  for(byte i=0;i<4;i++) bt[i] = EEPROM.read(offset+i);
+  for(byte i=0;i<4;i++) EEPROM_readAnything(offset+4+4*i, flt[i]);
+}
+
+void PrototypeOutputCard::SerialReceiveStart()
+{
+}
+
+void PrototypeOutputCard::SerialReceiveDuring(byte val, byte index)
+{
+  message.Receive(val, index);
+}
+
+void PrototypeOutputCard::SerialReceiveAfter(int offset)
+{
+  for(byte i=0;i<4;i++)
+  {
+    bt[i] = message.asBytes[i];
+    flt[i] = message.asFloat[i];
+  }
+  BackupParams(offset);
+}
+
+void PrototypeOutputCard::SerialID()
+{
+  Serial.print(F(" OID0"));
+}
+
+// called from the watchdog interrupt, so keep it short
+void PrototypeOutputCard::Disable()
+{
+  /*put the output in its safe state*/
+}
+
+// the controller's output runs from this to 100.  -100 for an output that heats and cools
+double PrototypeOutputCard::OutputMin()
+{
+  return 0;
+}
+
+void PrototypeOutputCard::Write(double value)
+{
+  /*your code here*/
+}
+
+void PrototypeOutputCard::SerialSend()
+{
+  for(byte i=0;i<4;i++)
+  {
+    Serial.print(int(bt[i]));
+    Serial.print(' ');
+  }
+  for(byte i=0;i<4;i++)
+  {
+    if(i) Serial.print(' ');
+    PrintNumber(Serial, flt[i]);
+  }
+  Serial.println();
+}
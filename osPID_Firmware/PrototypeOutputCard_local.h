@@ -0,0 +1,36 @@
+#ifndef PrototypeOutputCard_h
+#define PrototypeOutputCard_h
+
+#include "IOCard_local.h"
+
+/**********************************************************************************************
+ * Generic prototype output card, with the output specified by the user: add whatever it
+ * needs to PrototypeOutputCard.cpp.  4 bytes and 4 floats of settings are kept in the
+ * eeprom and exchanged with processing for it to use.  see IOCard_local.h for the members
+ * every card has.
+ **********************************************************************************************/
+class PrototypeOutputCard
+{
+  public:
+    PrototypeOutputCard();
+
+    void Initialize();
+    void Write(double);
+    void Disable();
+    void BackupParams(int);
+    void RestoreParams(int);
+    void SerialReceiveStart();
+    void SerialReceiveDuring(byte, byte);
+    void SerialReceiveAfter(int);
+    void SerialSend();
+    void SerialID();
+    double OutputMin();
+
+    byte bt[4];
+    float flt[4];
+
+  private:
+    CardMessage<4,4> message;
+};
+
+#endif
@@ -0,0 +1,102 @@
+/**********************************************************************************************
+ * Smith predictor for the osPID
+ *
+ * Wraps the PID with a first order plus dead time model of the process. the PID is
+ * fed the measured input plus the difference between the model's response without
+ * and with the dead time, so it can be tuned as though the dead time weren't there.
+ **********************************************************************************************/
+
+#if ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+#include "SmithPredictor_local.h"
+
+/*Constructor (...)*********************************************************
+* Defaults to a unity gain process with a 60 second time constant and 10
+* seconds of dead time until a model is uploaded or identified.
+***************************************************************************/
+SmithPredictor::SmithPredictor(double* Input, double* Output, double* Corrected)
+{
+    myInput = Input;
+    myOutput = Output;
+    myCorrected = Corrected;
+    gain = 1;
+    SetModel(1, 60, 10);
+}
+
+/* Compute() ******************************************************************
+* The dead time is split into SP_DELAY_STEPS equal steps.  the model advances
+* one step at a time (catching up if we've been called late) and the history
+* is a ring, so nothing gets shifted along.
+******************************************************************************/
+void SmithPredictor::Compute()
+{
+   unsigned long now = millis();
+   if(now - lastTime > stepTime * SP_DELAY_STEPS) Reset(); //we haven't run for a whole dead time
+   while(now - lastTime >= stepTime)
+   {
+      Step();
+      lastTime += stepTime;
+   }
+   *myCorrected = *myInput + model - history[head];
+}
+
+void SmithPredictor::Step()
+{
+   model = a * model + (1 - a) * gain * (*myOutput);
+   history[head] = model;
+   if(++head == SP_DELAY_STEPS) head = 0;
+}
+
+/* Reset() ********************************************************************
+* Puts the model at steady state for the present output. with the delayed
+* and undelayed responses equal, the correction starts at zero.
+******************************************************************************/
+void SmithPredictor::Reset()
+{
+   model = gain * (*myOutput);
+   for(unsigned char i=0;i<SP_DELAY_STEPS;i++) history[i] = model;
+   head = 0;
+   lastTime = millis();
+}
+
+/* SetModel(...) **************************************************************
+* Gain is in input units per output unit and may be negative for a reverse
+* acting process.  invalid models are ignored.
+******************************************************************************/
+void SmithPredictor::SetModel(double Gain, double TimeConstant, double DeadTime)
+{
+   if(Gain == 0 || isnan(Gain) || !(TimeConstant > 0) || !(DeadTime >= 0)) return;
+   gain = Gain;
+   tau = TimeConstant;
+   deadTime = DeadTime;
+   stepTime = (unsigned long)(deadTime * 1000 / SP_DELAY_STEPS);
+   if(stepTime < 1) stepTime = 1;
+   a = exp(-((double)stepTime / 1000) / tau);
+   Reset();
+}
+
+/* SetModelFromRelay(...) *****************************************************
+* A relay test gives the ultimate gain Ku and period Pu (sec.) for a first
+* order plus dead time process with gain K they satisfy
+*    K*Ku = sqrt(1 + (w*tau)^2)   and   w*theta + atan(w*tau) = pi
+* with w = 2*pi/Pu, which is enough to solve for tau and theta.  returns
+* false (and leaves the model alone) if the numbers don't fit.
+******************************************************************************/
+bool SmithPredictor::SetModelFromRelay(double Ku, double Pu)
+{
+   double kk = abs(gain) * Ku;
+   if(!(Pu > 0) || !(kk > 1)) return false;
+   double w = 2 * 3.14159 / Pu;
+   double t = sqrt(kk * kk - 1) / w;
+   double th = (3.14159 - atan(w * t)) / w;
+   SetModel(gain, t, th);
+   return true;
+}
+
+double SmithPredictor::GetGain(){ return gain; }
+double SmithPredictor::GetTimeConstant(){ return tau; }
+double SmithPredictor::GetDeadTime(){ return deadTime; }
@@ -0,0 +1,47 @@
+#ifndef SmithPredictor_h
+#define SmithPredictor_h
+
+#define SP_DELAY_STEPS 32                 // length of the dead time history
+
+class SmithPredictor
+{
+
+
+  public:
+
+  //commonly used functions **************************************************************************
+    SmithPredictor(double*, double*,      // * constructor.  links the predictor to the measured Input,
+                   double*);              //   the Output, and the corrected input the PID should use
+
+    void Compute();                       // * advances the internal model and updates the corrected
+                                          //   input.  call it before the PID computes
+
+    void Reset();                         // * restarts the model at steady state for the current
+                                          //   output, so switching the predictor on is bumpless
+
+    void SetModel(double, double,         // * first order plus dead time model: process gain,
+                  double);                //   time constant (sec) and dead time (sec)
+
+    bool SetModelFromRelay(double,        // * keeps the process gain and works out the time constant
+                           double);       //   and dead time from a relay test's ultimate gain & period
+
+  //Display functions ****************************************************************
+    double GetGain();
+    double GetTimeConstant();
+    double GetDeadTime();
+
+  private:
+    void Step();
+
+    double *myInput;
+    double *myOutput;
+    double *myCorrected;
+
+    double gain, tau, deadTime;
+    double a;                             // * per-step decay of the model
+    double model;                         // * model response without the dead time
+    float history[SP_DELAY_STEPS];        // * circular buffer of past model responses
+    unsigned char head;                   //   (head is the oldest)
+    unsigned long stepTime, lastTime;
+};
+#endif
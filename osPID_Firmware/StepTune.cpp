@@ -0,0 +1,172 @@
+/**********************************************************************************************
+ * Step response autotune for the osPID
+ *
+ * An open loop alternative to the relay autotune for processes that can't be made to
+ * oscillate.  the output is stepped once and a first order plus dead time model is
+ * read off the response as it comes in: the tangent at the steepest point of the rise
+ * gives the dead time, and comparing that point with a later one gives the time
+ * constant and the gain.  the test ends once the rise has slowed to 1/e of its steepest,
+ * about one time constant after the dead time, and nothing is stored but a handful of
+ * numbers.
+ **********************************************************************************************/
+
+#if ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+#include "StepTune_local.h"
+
+const double STEP_TIMEOUT = 7200; //sec to wait for the input to move at all
+
+/*Constructor (...)*********************************************************
+* same defaults as the relay autotune
+***************************************************************************/
+StepTune::StepTune(double* Input, double* Output)
+{
+    input = Input;
+    output = Output;
+    noiseBand = 0.5;
+    oStep = 30;
+    sampleTime = 250;
+    running = false;
+    SetLookbackSec(10);
+    gain = 0;
+    tau = 0;
+    deadTime = 0;
+    lastTime = millis();
+}
+
+void StepTune::Cancel()
+{
+    running = false;
+}
+
+/* Runtime() ******************************************************************
+* the input is low-pass filtered, which delays the steepest point by about
+* the filter's time constant, so that much is taken back off the dead time.
+* the test ends once the slope has dropped to 1/e of its peak.
+******************************************************************************/
+int StepTune::Runtime()
+{
+   unsigned long now = millis();
+   if(now - lastTime < (unsigned long)sampleTime) return 0;
+   lastTime = now;
+   double y = *input;
+
+   if(!running)
+   { //step the output and start watching
+      running = true;
+      y0 = y;
+      yFilt = y;
+      maxSlope = 0;
+      direction = 0;
+      outputStart = *output;
+      *output = outputStart + oStep;
+      startTime = now;
+      return 0;
+   }
+
+   double dt = (double)sampleTime / 1000;
+   double last = yFilt;
+   yFilt += (y - yFilt) * dt / (filterTime + dt);
+
+   if(direction == 0)
+   {
+      if(abs(y - y0) > noiseBand) direction = (y > y0) ? 1 : -1;
+      else if((now - startTime) / 1000 > STEP_TIMEOUT)
+      {
+         *output = outputStart;
+         running = false;
+         return -1;
+      }
+      return 0;
+   }
+
+   double slope = direction * (yFilt - last) / dt;
+   if(slope > maxSlope)
+   {
+      maxSlope = slope;
+      yAtMax = yFilt;
+      timeAtMax = now;
+   }
+   //give the filter a couple of time constants past the peak so noise
+   //right after it can't end the test early
+   if(maxSlope <= 0 || slope > maxSlope * 0.3679 || now - timeAtMax < 2000 * filterTime) return 0;
+
+   //a first order response obeys dy/dt = (final - y)/tau everywhere past the
+   //dead time.  applying that at the steepest point and here gives tau and
+   //the final value without waiting for it
+   double rise = direction * (yFilt - y0);
+   tau = (rise - direction * (yAtMax - y0)) / (maxSlope - slope);
+   double total = rise + tau * slope;   //where it's heading, the way it went
+   gain = direction * total / oStep;
+   deadTime = (double)(timeAtMax - startTime) / 1000 - direction * (yAtMax - y0) / maxSlope - filterTime;
+   if(deadTime < 0) deadTime = 0;
+   *output = outputStart;
+   running = false;
+
+   //a response that doesn't fit the model (noise mistaken for the peak, an
+   //overshoot) gives a negative tau, or a final value on the wrong side of
+   //the start, which flips the sign of the gain.  none of it is worth keeping
+   if(!(tau > 0) || !(total > 0) || isinf(tau)) return -1;
+   if(isnan(gain) || isinf(gain) || isnan(deadTime) || isinf(deadTime)) return -1;
+   return 1;
+}
+
+void StepTune::SetOutputStep(double Step)
+{
+   oStep = Step;
+}
+
+void StepTune::SetNoiseBand(double Band)
+{
+   noiseBand = Band;
+}
+
+void StepTune::SetLookbackSec(int value)
+{
+   if(value < 1) value = 1;
+   filterTime = (double)value / 4;
+}
+
+/* Tunings ********************************************************************
+* SIMC PI rules with the closed loop time constant equal to the dead time
+* (half the time constant if there's no dead time to speak of.)
+******************************************************************************/
+double StepTune::GetKp()
+{
+   if(gain == 0) return 0;
+   double tc = deadTime > 0 ? deadTime : tau / 2;
+   return tau / (abs(gain) * (tc + deadTime));
+}
+
+double StepTune::GetKi()
+{
+   double tc = deadTime > 0 ? deadTime : tau / 2;
+   double ti = 4 * (tc + deadTime);
+   if(tau < ti) ti = tau;
+   if(!(ti > 0)) return 0;
+   return GetKp() / ti;
+}
+
+double StepTune::GetKd()
+{
+   return 0;
+}
+
+double StepTune::GetGain()
+{
+   return gain;
+}
+
+double StepTune::GetTimeConstant()
+{
+   return tau;
+}
+
+double StepTune::GetDeadTime()
+{
+   return deadTime;
+}
@@ -0,0 +1,46 @@
+#ifndef StepTune_h
+#define StepTune_h
+
+class StepTune
+{
+
+
+  public:
+  //commonly used functions **************************************************************************
+    StepTune(double*, double*);           // * constructor.  links the step test to the Input and Output
+
+    int Runtime();                        // * like PID_ATune::Runtime.  returns 1 when it has a model,
+                                          //   -1 if it gave up (the input never moved, or the model
+                                          //   that came out is no good), 0 otherwise
+
+    void Cancel();                        // * stops the test.  the output is left where it is
+
+    void SetOutputStep(double);           // * how far the output is stepped from where it started
+
+    void SetNoiseBand(double);            // * the input has to move more than this before the
+                                          //   response counts as started
+
+    void SetLookbackSec(int);             // * smoothing applied to the input (sec.)  noisier
+                                          //   inputs need more
+
+  //Display functions ****************************************************************
+    double GetKp();                       // * PI tunings from the model (SIMC rules)
+    double GetKi();
+    double GetKd();
+    double GetGain();                     // * the identified first order plus dead time model
+    double GetTimeConstant();
+    double GetDeadTime();
+
+  private:
+    double *input, *output;
+    double oStep, noiseBand, outputStart;
+    double filterTime;                    // * time constant of the input filter (sec)
+    double y0, yFilt;                     // * starting input, filtered input
+    double maxSlope, yAtMax;              // * steepest filtered rise, and where it happened
+    double gain, tau, deadTime;
+    unsigned long startTime, timeAtMax, lastTime;
+    int sampleTime;
+    char direction;                       // * which way the input went (0 = hasn't left the band)
+    bool running;
+};
+#endif
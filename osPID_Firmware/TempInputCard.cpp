@@ -0,0 +1,156 @@
+#include "TempInputCard_local.h"
+#include "EEPROMAnything.h"
+#include "NumberFormat_local.h"
+
+const byte thermistorPin = A6;
+const byte thermocoupleCS = 10;
+const byte thermocoupleSO = 12;
+const byte thermocoupleCLK = 13;
+
+static double ReadCelsius(MAX6675 &chip, byte)
+{ //type K only
+  return chip.readCelsius();
+}
+
+// how many of the thermocouple_t types the chip can be set up for
+static byte ThermocoupleTypes(MAX6675 &) { return 1; }
+static byte ThermocoupleTypes(MAX31855 &) { return THERMOCOUPLE_TYPES; }
+
+static double ReadCelsius(MAX31855 &chip, byte type)
+{
+  int thermocouple, junction;
+  if(chip.readCounts(&thermocouple, &junction) != MAX31855_OK) return NAN;
+  if(MAX31855Linearize((thermocouple_t)type, thermocouple, junction, &thermocouple) != MAX31855_OK) return NAN;
+  return thermocouple * 0.25;
+}
+
+template <class Thermocouple, byte ID> static void Defaults(TempInputCard<Thermocouple, ID> &card)
+{
+  card.inputType = 0;
+  card.thermocoupleType = THERMOCOUPLE_K;
+  card.thermistorNominal = 10;
+  card.bCoefficient = 1;
+  card.temperatureNominal = 293.15;
+  card.referenceResistance = 10;
+}
+
+template<> TempInputCard<MAX6675, 1>::TempInputCard()
+  : thermocouple(thermocoupleCLK, thermocoupleCS, thermocoupleSO)
+{
+  Defaults(*this);
+}
+
+template<> TempInputCard<MAX31855, 2>::TempInputCard()
+  : thermocouple(thermocoupleSO, thermocoupleCS, thermocoupleCLK)
+{
+  Defaults(*this);
+}
+
+template <class Thermocouple, byte ID> void TempInputCard<Thermocouple, ID>::Initialize()
+{
+}
+
+template <class Thermocouple, byte ID> void TempInputCard<Thermocouple, ID>::BackupParams(int offset)
+{
+  EEPROM.write(offset, inputType);
+  EEPROM.write(offset+1, thermocoupleType);
+  EEPROM_writeAnything(offset+2,thermistorNominal);
+  EEPROM_writeAnything(offset+6,bCoefficient);
+  EEPROM_writeAnything(offset+10,temperatureNominal);
+  EEPROM_writeAnything(offset+14,referenceResistance);
+}
+
+template <class Thermocouple, byte ID> void TempInputCard<Thermocouple, ID>::RestoreParams(int offset)
+{
+  inputType = EEPROM.read(offset);
+  thermocoupleType = EEPROM.read(offset+1);
+  if(thermocoupleType >= ThermocoupleTypes(thermocouple)) thermocoupleType = THERMOCOUPLE_K;
+  EEPROM_readAnything(offset+2,thermistorNominal);
+  EEPROM_readAnything(offset+6,bCoefficient);
+  EEPROM_readAnything(offset+10,temperatureNominal);
+  EEPROM_readAnything(offset+14,referenceResistance);
+}
+
+template <class Thermocouple, byte ID> void TempInputCard<Thermocouple, ID>::SerialReceiveStart()
+{
+  newType = 0xFF;
+}
+
+template <class Thermocouple, byte ID> void TempInputCard<Thermocouple, ID>::SerialReceiveDuring(byte val, byte index)
+{
+  if(index==18) newType = val; //optional: the thermocouple type, after the floats
+  else message.Receive(val, index);
+}
+
+template <class Thermocouple, byte ID> void TempInputCard<Thermocouple, ID>::SerialReceiveAfter(int offset)
+{
+  inputType = message.asBytes[0];
+  thermistorNominal = message.asFloat[0];
+  bCoefficient = message.asFloat[1];
+  temperatureNominal = message.asFloat[2];
+  referenceResistance = message.asFloat[3];
+  if(newType < ThermocoupleTypes(thermocouple)) thermocoupleType = newType;
+  BackupParams(offset);
+}
+
+template <class Thermocouple, byte ID> void TempInputCard<Thermocouple, ID>::SerialSend()
+{
+  Serial.print((int)inputType);
+  Serial.print(' ');
+  PrintNumber(Serial, thermistorNominal);
+  Serial.print(' ');
+  PrintNumber(Serial, bCoefficient);
+  Serial.print(' ');
+  PrintNumber(Serial, temperatureNominal);
+  Serial.print(' ');
+  PrintNumber(Serial, referenceResistance);
+  if(ThermocoupleTypes(thermocouple) > 1)
+  {
+    Serial.print(' ');
+    Serial.print((int)thermocoupleType);
+  }
+  Serial.println();
+}
+
+template <class Thermocouple, byte ID> void TempInputCard<Thermocouple, ID>::SerialID()
+{
+  Serial.print(F(" IID"));
+  Serial.print((int)ID);
+}
+
+template <class Thermocouple, byte ID> double TempInputCard<Thermocouple, ID>::ReadThermistor(int voltage)
+{
+  float R = referenceResistance / (1024.0/(float)voltage - 1);
+  float steinhart;
+  steinhart = R / thermistorNominal;           // (R/Ro)
+  steinhart = log(steinhart);                  // ln(R/Ro)
+  steinhart /= bCoefficient;                   // 1/B * ln(R/Ro)
+  steinhart += 1.0 / (temperatureNominal + 273.15); // + (1/To)
+  steinhart = 1.0 / steinhart;                 // Invert
+  steinhart -= 273.15;                         // convert to C
+
+  return steinhart;
+}
+
+template <class Thermocouple, byte ID> double TempInputCard<Thermocouple, ID>::Read()
+{
+  if(inputType == 0) return ReadCelsius(thermocouple, thermocoupleType);
+  else if(inputType == 1)
+  {
+    int adcReading = analogRead(thermistorPin);
+    // If either thermistor or reference resistor is not connected
+    if ((adcReading == 0) || (adcReading == 1023))
+    {
+      return NAN;
+    }
+    else
+    {
+      return ReadThermistor(adcReading);
+    }
+  }
+  return NAN;
+}
+
+// both cards are compiled whichever one io.h picks; the linker drops the other
+template class TempInputCard<MAX6675, 1>;
+template class TempInputCard<MAX31855, 2>;
@@ -0,0 +1,57 @@
+#ifndef TempInputCard_h
+#define TempInputCard_h
+
+#include "IOCard_local.h"
+#include "max6675_local.h"
+#include "MAX31855_local.h"
+
+/**********************************************************************************************
+ * Temperature Basic input cards: 1 thermistor and 1 type-K thermocouple.  V1.10 and V1.20
+ * only differ in the thermocouple chip, so they're the same class with the chip (and the
+ * ID reported in the info line) as template parameters.  see IOCard_local.h for the
+ * members every card has.
+ *
+ * on V1.20 the reading is corrected for the thermocouple's curve (see MAX31855Linearize),
+ * so the card needs to know which MAX31855 variant is fitted.  the config message from
+ * processing can end with the thermocouple type, and the type ends the line sent back.
+ * V1.10 is type K only: it ignores a type in the message and doesn't send one.
+ *
+ * eeprom: input type (0 thermocouple, 1 thermistor), thermocouple type (thermocouple_t,
+ * always K on V1.10), then the thermistor's nominal resistance, B coefficient, nominal
+ * temperature and reference resistance
+ **********************************************************************************************/
+template <class Thermocouple, byte ID> class TempInputCard
+{
+  public:
+    TempInputCard();
+
+    void Initialize();
+    double Read();
+    void BackupParams(int);
+    void RestoreParams(int);
+    void SerialReceiveStart();
+    void SerialReceiveDuring(byte, byte);
+    void SerialReceiveAfter(int);
+    void SerialSend();
+    void SerialID();
+
+    double ReadThermistor(int);           // * temperature from a thermistor adc reading
+
+    Thermocouple thermocouple;
+    byte inputType;
+    byte thermocoupleType;                // * thermocouple_t
+    double thermistorNominal, bCoefficient, temperatureNominal, referenceResistance;
+
+  private:
+    CardMessage<1,4> message;
+    byte newType;                         // * thermocouple type in the message, 0xFF for none
+};
+
+typedef TempInputCard<MAX6675, 1> TempInputV110;
+typedef TempInputCard<MAX31855, 2> TempInputV120;
+
+// the chips are wired to the same pins but take them in a different order
+template<> TempInputCard<MAX6675, 1>::TempInputCard();
+template<> TempInputCard<MAX31855, 2>::TempInputCard();
+
+#endif
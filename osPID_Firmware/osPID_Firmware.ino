@@ -1,39 +1,61 @@
 //#define USE_SIMULATION
+//#define USE_BENCHMARK
 
 #include <LiquidCrystal.h>
 #include <EEPROM.h>
+#include <avr/wdt.h>
+#include <avr/interrupt.h>
 #include "AnalogButton_local.h"
 #include "PID_v1_local.h"
 #include "EEPROMAnything.h"
 #include "PID_AutoTune_v0_local.h"
+#include "SmithPredictor_local.h"
+#include "NumberFormat_local.h"
+#include "OnlineTune_local.h"
+#include "StepTune_local.h"
+#include "ModbusRtu_local.h"
 #include "io.h"
 
+// USE_REPLAY is set by the PC replay tool in replay/, never in the sketch
+#ifdef USE_REPLAY
+double ReplayInput();
+#endif
+
 // ***** PIN ASSIGNMENTS *****
 
 const byte buzzerPin = 3;
+const byte txEnablePin = 2; //RS-485 driver enable, for the bus and modbus protocols
 const byte systemLEDPin = A2;
 
-const byte EEPROM_ID = 2; //used to automatically trigger and eeprom reset after firmware update (if necessary)
-
-const byte TYPE_NAV=0;
-const byte TYPE_VAL=1;
-const byte TYPE_OPT=2;
+const byte EEPROM_ID = 4; //used to automatically trigger and eeprom reset after firmware update (if necessary.)  bump it whenever the layout below moves
 
-byte mMain[] = {
-  0,1,2,3};
-byte mDash[] = {
-  4,5,6,7};
-byte mConfig[] = {
-  8,9,10,11};
-byte *mMenu[] = {
-  mMain, mDash, mConfig};
+//sizes are the AVR's.  anything stored that's 16 bits there is declared uint16_t, so the replay build keeps the same layout
+const int eepromTuningOffset = 1; //13 bytes
+const int eepromDashOffset = 14; //9 bytes
+const int eepromATuneOffset = 23; //11 bytes
+const int eepromProfileOffset = 35; //145 bytes
+const int eepromInputOffset = 180; //? bytes (depends on the card)
+const int eepromOutputOffset = 300; //? bytes (depends on the card)
+const int eepromFilterOffset = 340; //12 bytes
+const int eepromGainOffset = 352; //66 bytes
+const int eepromSmithOffset = 418; //13 bytes
+const int eepromLogConfigOffset = 431; //2 bytes
+const int eepromSafetyOffset = 433; //8 bytes
+const int eepromTripOffset = 441; //5 bytes
+const int eepromAdaptOffset = 446; //25 bytes
+const int eepromAlarmOffset = 471; //25 bytes
+const int eepromReportOffset = 496; //15 bytes
+const int eepromSerialOffset = 511; //2 bytes
+const int eepromResumeOffset = 513; //61 bytes
+const int eepromConfigOffset = 574; //1 byte, set while a config snapshot is being written
+const int eepromLogOffset = 576; //448 bytes, to the end of the EEPROM
 
 byte curMenu=0, mIndex=0, mDrawIndex=0;
 LiquidCrystal lcd(A1, A0, 4, 7, 8, 9);
 AnalogButton button(A3, 0, 253, 454, 657);
 
 unsigned long now, lcdTime, buttonTime,ioTime, serialTime;
-boolean sendInfo=true, sendDash=true, sendTune=true, sendInputConfig=true, sendOutputConfig=true;
+boolean sendInfo=true, sendDash=true, sendTune=true, sendInputConfig=true, sendOutputConfig=true, sendGain=false, sendSmith=false, sendMem=false, sendSafety=false, sendAdapt=false, sendAlarm=false, sendReport=false, sendConfig=false, sendResume=false;
 
 bool editing=false;
 bool inputOk = true;
@@ -42,16 +64,57 @@ bool tuning = false;
 double setpoint=250,input=250,output=50, pidInput=250;
 
 double kp = 2, ki = 0.5, kd = 2;
+double filterN = 10, weightB = 1, weightC = 0; //derivative filter and setpoint weights
 byte ctrlDirection = 0;
 byte modeIndex = 0;
 byte highlightedIndex=0;
 
 PID myPID(&pidInput, &output, &setpoint,kp,ki,kd, DIRECT);
+const double trackingGain = 0.5; //fraction of the clipped output fed back into the integral
 
 double aTuneStep = 20, aTuneNoise = 1;
-unsigned int aTuneLookBack = 10;
+uint16_t aTuneLookBack = 10;
 byte ATuneModeRemember = 0;
+byte aTuneMethod = 0; //0=relay (oscillates around the setpoint), 1=single open loop step
 PID_ATune aTune(&pidInput, &output);
+StepTune sTune(&pidInput, &output);
+
+/*Gain schedule declarations*/
+const byte nGainSteps = 4;
+byte gainSource = 0; //0=off, 1=keyed on setpoint, 2=keyed on input
+byte gainCount = 0;  //breakpoints in use (stored in EEPROM in ascending order)
+
+/*Smith predictor: when on, the pid sees the input corrected by a dead time model*/
+byte smithOn = 0;
+SmithPredictor predictor(&input, &output, &pidInput);
+
+/*Online adaptation: the model is fitted to the measured input and the applied output*/
+byte adaptMode = 0; //0=off, 1=propose tunings, 2=apply them
+double adaptSample = 2, adaptDeadTime = 0; //sec
+double adaptKpMin = 0.1, adaptKpMax = 50, adaptKiMin = 0.001, adaptKiMax = 10;
+double adaptKp = 0, adaptKi = 0; //latest proposal. 0 = none
+const double adaptConfidence = 0.8; //needed before a proposal is applied
+byte adaptCount = 0; //model samples since tunings were last applied
+OnlineTune adapt(&input, &output);
+
+/*Serial protocol: the Processing one, the same addressed on a multi-drop
+  bus, or Modbus RTU for SCADA*/
+const byte PROTOCOL_LEGACY = 0, PROTOCOL_MODBUS = 1, PROTOCOL_BUS = 2;
+byte serialProtocol = PROTOCOL_LEGACY;
+byte busAddress = 1;
+ModbusRtu modbus(&Serial, 9600, ModbusRead, ModbusWrite);
+byte modbusSave = 0; //settings to back up once the request is done
+
+/*Data logger declarations*/
+const byte logBlockSize = 64;
+const byte nLogBlocks = 7;
+const double logLimit = 5e8; //tenths.  anything past it is logged as it, which keeps the zigzag of a change inside a long
+uint16_t logInterval = 0; //0 = logging off
+unsigned long logTime = 0;
+byte logBlock = 0, logPos = 0, logSeq = 254;
+long logLast[3];
+boolean logDump = false; //a download was asked for
+boolean logResync = false; //the next record is the first since a reset
 
 
 byte curProfStep=0;
@@ -68,12 +131,291 @@ const unsigned long profReceiveTimeout = 10000;
 unsigned long profReceiveStart=0;
 boolean receivingProfile=false;
 const int nProfSteps = 15;
-char profname[] = {
-  'N','o',' ','P','r','o','f'};
-byte proftypes[nProfSteps];
-unsigned long proftimes[nProfSteps];
-float profvals[nProfSteps];
+char profname[] = "No Prof"; //the steps themselves are read from EEPROM as needed
 boolean runningProfile = false;
+boolean profileHeld = false; //resumed after a power cut, waiting to be told to carry on
+unsigned long heldElapsed = 0;
+const byte PROFILE_ABORT = 0, PROFILE_HOLD = 1, PROFILE_RESUME = 2; //what a power cut does to it
+byte resumePolicy = PROFILE_ABORT;
+const byte nCheckpoints = 4;
+const byte checkpointSize = 15; //sequence, step, elapsed ms, helperVal, setpoint, check
+const byte checkpointDone = 0xFF; //the step once the profile is over
+const unsigned long checkpointInterval = 900000; //ms.  what a resume can repeat
+byte checkpointSlot = 0, checkpointSeq = 0; //the latest
+unsigned long checkpointTime = 0;
+
+
+/********************************************
+ * Memory diagnostics
+ * the RAM between the globals and the stack is painted
+ * with a canary before main() runs.  however far the
+ * canary survives is how close the stack has come to
+ * the globals.
+ ********************************************/
+const byte STACK_CANARY = 0xC5;
+byte resetCause __attribute__ ((section (".noinit"))); //MCUSR at boot. 0 if the bootloader already cleared it
+unsigned int stackUnused = 0, minFreeRam = 0xFFFF;
+
+#ifndef USE_REPLAY
+extern uint8_t _end;
+extern uint8_t __stack;
+extern int __heap_start, *__brkval;
+
+// runs from .init1, before the stack pointer is even set up, so
+// it's done in assembly with no stack use at all
+void StackPaint(void) __attribute__ ((naked)) __attribute__ ((section (".init1")));
+void StackPaint(void)
+{
+  __asm volatile ("    ldi r30,lo8(_end)\n"
+                  "    ldi r31,hi8(_end)\n"
+                  "    ldi r24,lo8(0xc5)\n" /* STACK_CANARY */
+                  "    ldi r25,hi8(__stack)\n"
+                  "    rjmp .cmp\n"
+                  ".loop:\n"
+                  "    st Z+,r24\n"
+                  ".cmp:\n"
+                  "    cpi r30,lo8(__stack)\n"
+                  "    cpc r31,r25\n"
+                  "    brlo .loop\n"
+                  "    breq .loop"::);
+}
+
+// after a watchdog reset the watchdog stays on, so it has to be
+// turned off before the C runtime gets going (.init3)
+void WatchdogOff(void) __attribute__ ((naked)) __attribute__ ((section (".init3")));
+void WatchdogOff(void)
+{
+  resetCause = MCUSR;
+  MCUSR = 0;
+  wdt_disable();
+}
+
+int FreeRam()
+{
+  int v;
+  return (int) &v - (__brkval == 0 ? (int) &__heap_start : (int) __brkval);
+}
+
+void MemoryScan()
+{ //nothing uses the heap, so the untouched canary starts right at _end
+  uint8_t *p = &_end;
+  unsigned int n = 0;
+  while(p <= &__stack && *p == STACK_CANARY)
+  {
+    p++;
+    n++;
+  }
+  stackUnused = n;
+  unsigned int f = FreeRam();
+  if(f < minFreeRam) minFreeRam = f;
+}
+#else
+// the replay tool runs on the PC, where none of this means anything
+int FreeRam(){ return 0; }
+void MemoryScan(){}
+#endif /*USE_REPLAY*/
+
+
+/********************************************
+ * Fail-safe supervisor
+ * each stage of loop() stamps the time it last ran.
+ * the watchdog is only fed while every stage is on
+ * time.  if one stalls, the watchdog interrupt turns
+ * the outputs off and notes the stall, the timeout
+ * after that resets the chip, and setup() records
+ * the stall in EEPROM.
+ * over-temperature and rate-of-rise are checked on
+ * the raw input, independently of the pid, and trip
+ * the outputs off until cleared over serial.
+ ********************************************/
+const byte STAGE_BUTTON = 0, STAGE_IO = 1, STAGE_LCD = 2, STAGE_SERIAL = 3;
+const byte nStages = 4;
+const unsigned int stageDeadline[nStages] = {
+  250, 750, 750, 1500}; //ms since each stage last ran
+unsigned long stageTime[nStages];
+
+const byte TRIP_NONE = 0, TRIP_STALL = 1, TRIP_OVERTEMP = 2, TRIP_RISE = 3;
+volatile byte tripCode = TRIP_NONE;
+float maxTemp = 0, maxRise = 0; //deg, deg/min.  0 turns a check off
+float riseRef = 0;
+unsigned long riseTime = 0;
+const unsigned long riseWindow = 10000;
+
+byte StaleStages()
+{
+  byte mask = 0;
+  unsigned long t = millis();
+  for(byte i=0;i<nStages;i++) if(t - stageTime[i] > stageDeadline[i]) mask |= 1<<i;
+  return mask;
+}
+
+void WatchdogStart()
+{ //1s timeout, interrupt first then reset
+  for(byte i=0;i<nStages;i++) stageTime[i] = millis();
+  cli();
+  wdt_reset();
+  WDTCSR = (1<<WDCE) | (1<<WDE);
+  WDTCSR = (1<<WDIE) | (1<<WDE) | (1<<WDP2) | (1<<WDP1);
+  sei();
+}
+
+// for the jobs that keep loop() busy on purpose (a log download, a config
+// blob): they're getting somewhere, so nothing has stalled
+void WatchdogKeepAlive()
+{
+  wdt_reset();
+  for(byte i=0;i<nStages;i++) stageTime[i] = millis();
+}
+
+void Supervise()
+{
+  if(StaleStages()) return; //let the watchdog bite
+  wdt_reset();
+  WDTCSR |= (1<<WDIE); //the interrupt disarms itself when it fires
+}
+
+// the interrupt can't write EEPROM: it takes 17ms, and would spoil any write
+// it cut into.  the stalled stages wait in RAM the reset leaves alone, with
+// a check byte, for StallRecord
+byte stallMark[2] __attribute__ ((section (".noinit")));
+
+ISR(WDT_vect)
+{
+  DisableOutputCard();
+  tripCode = TRIP_STALL;
+  stallMark[0] = 0x80 | StaleStages();
+  stallMark[1] = ~stallMark[0];
+}
+
+void StallRecord()
+{ //resetCause is 0 if the bootloader cleared MCUSR first; the check byte has to do then
+  byte mark = stallMark[0];
+  boolean noted = (mark & 0x80) && stallMark[1]==(byte)~mark;
+  stallMark[0] = stallMark[1] = 0;
+  if(!noted || (resetCause!=0 && !(resetCause & (1<<WDRF)))) return;
+  EEPROM.write(eepromTripOffset, TRIP_STALL);
+  EEPROM_writeAnything(eepromTripOffset+1, (float)(mark & 0x7F));
+}
+
+void Trip(byte code, float value)
+{
+  if(tripCode!=TRIP_NONE) return;
+  tripCode = code;
+  EEPROM.write(eepromTripOffset, code);
+  EEPROM_writeAnything(eepromTripOffset+1, value);
+  if(tuning) changeAutoTune();
+  if(runningProfile) StopProfile();
+  if(serialProtocol!=PROTOCOL_LEGACY) return;
+  Serial.print(F("TRIP "));
+  Serial.print(int(code));
+  Serial.print(' ');
+  PrintNumber(Serial, value);
+  Serial.println();
+}
+
+void CheckSafety()
+{
+  if(!inputOk) return;
+  if(maxTemp!=0 && input>maxTemp) Trip(TRIP_OVERTEMP, input);
+  if(now - riseTime >= riseWindow)
+  {
+    float rise = (input - riseRef) * 60000.0 / (now - riseTime);
+    if(maxRise!=0 && riseTime!=0 && rise>maxRise) Trip(TRIP_RISE, rise);
+    riseRef = input;
+    riseTime = now;
+  }
+}
+
+/********************************************
+ * Alarms
+ * unlike a trip, an alarm only warns: it sounds the
+ * buzzer and sends an ALARM line, and the output is
+ * left alone.  each limit has to be exceeded to raise
+ * its alarm and backed off by the hysteresis to clear
+ * it.  latching alarms stay up after the condition
+ * clears until acknowledged over serial, and an
+ * acknowledge also silences whatever is still active.
+ * the overshoot alarm extrapolates the smoothed slope
+ * over the horizon and compares the predicted input
+ * with the setpoint it's approaching.
+ ********************************************/
+const byte ALARM_DEV_HIGH = 1, ALARM_DEV_LOW = 2, ALARM_RATE = 4, ALARM_OVERSHOOT = 8, ALARM_SENSOR = 16;
+float alarmDevHigh = 0, alarmDevLow = 0, alarmRate = 0; //deg, deg, deg/min.  0 turns an alarm off
+float alarmOvershoot = 0, alarmHorizon = 0; //deg, sec.  a 0 horizon turns the overshoot alarm off
+float alarmHyst = 0.5; //deg (deg/min for the rate alarm)
+byte alarmLatch = 0; //which alarms latch
+byte alarmActive = 0, alarmLatched = 0, alarmSilenced = 0;
+bool alarmSounding = false;
+float alarmSlope = 0, alarmLast = NAN; //deg/min, smoothed over about 5s
+const float alarmSmooth = 0.95; //per 250ms sample
+
+void AlarmCheck(byte bit, bool enabled, float value, float limit)
+{
+  if(!enabled) alarmActive &= ~bit;
+  else if(value>limit) alarmActive |= bit;
+  else if(value<limit-alarmHyst) alarmActive &= ~bit;
+}
+
+byte AlarmState()
+{
+  return alarmActive | alarmLatched;
+}
+
+void AlarmRunTime()
+{
+  byte was = AlarmState();
+  byte wasActive = alarmActive;
+  if(!inputOk)
+  {
+    alarmActive |= ALARM_SENSOR;
+    alarmLast = NAN;
+  }
+  else
+  {
+    alarmActive &= ~ALARM_SENSOR;
+    if(!isnan(alarmLast)) alarmSlope = alarmSmooth*alarmSlope + (1-alarmSmooth)*(input-alarmLast)*240;
+    alarmLast = input;
+
+    float err = input - setpoint;
+    AlarmCheck(ALARM_DEV_HIGH, alarmDevHigh!=0, err, alarmDevHigh);
+    AlarmCheck(ALARM_DEV_LOW, alarmDevLow!=0, -err, alarmDevLow);
+    AlarmCheck(ALARM_RATE, alarmRate!=0, abs(alarmSlope), alarmRate);
+    float over = 0;
+    float predicted = err + alarmSlope*alarmHorizon/60;
+    if(err<0 && alarmSlope>0) over = predicted;
+    else if(err>0 && alarmSlope<0) over = -predicted;
+    AlarmCheck(ALARM_OVERSHOOT, alarmHorizon!=0, over, alarmOvershoot);
+  }
+  alarmLatched |= alarmActive & ~wasActive & alarmLatch;
+  alarmSilenced &= alarmActive;
+
+  byte state = AlarmState();
+  if(state!=was && serialProtocol==PROTOCOL_LEGACY)
+  { //sent straight away rather than waiting for the next SerialSend
+    Serial.print(F("ALARM "));
+    Serial.print(int(state));
+    Serial.print(' ');
+    Serial.print(int(state & ~was));
+    Serial.print(' ');
+    PrintNumber(Serial, input);
+    Serial.print(' ');
+    PrintNumber(Serial, alarmSlope);
+    Serial.println();
+  }
+  bool sound = (state & ~alarmSilenced)!=0;
+  if(sound!=alarmSounding)
+  {
+    alarmSounding = sound;
+    //a profile buzz step keeps the buzzer on until it ends
+    digitalWrite(buzzerPin, (sound || (runningProfile && curType==127)) ? HIGH : LOW);
+  }
+}
+
+void AlarmAcknowledge()
+{
+  alarmLatched = 0;
+  alarmSilenced = alarmActive;
+}
 
 
 //for devlopment and demo purposes, it's useful to have a
@@ -84,23 +426,161 @@ boolean runningProfile = false;
 
 #ifdef USE_SIMULATION
 double kpmodel = 5, taup = 50, theta[30];
+byte thetaHead = 0; //theta[] is a ring. the oldest output is at the head
 const double outputStart = 50;
 const double inputStart=250;
 
 void DoModel()
 {
-  // Cycle the dead time
-  for(byte i=0;i<30;i++)
-  {
-    theta[i] = theta[i+1];
-  }
-  // Compute the input
-  input = (kpmodel / taup) *(theta[0]-outputStart) + (input-inputStart)*(1-1/taup)+inputStart + ((float)random(-10,10))/100;
+  // Compute the input from the output 30 samples ago
+  input = (kpmodel / taup) *(theta[thetaHead]-outputStart) + (input-inputStart)*(1-1/taup)+inputStart + ((float)random(-10,10))/100;
 }
 #else
 
 #endif /*USE_SIMULATION*/
 
+//the benchmarks time the control path pieces with micros() and
+//report them over serial once at startup as
+//  BENCH name calls total_us
+//followed by BENCH_DN.  the same build runs on the controller,
+//under simavr and on the PC (replay/bench.sh)
+#ifdef USE_BENCHMARK
+unsigned long benchStart, benchTotal = 0;
+volatile double benchSink; //keeps results from being optimized away
+
+class BenchPrint : public Print
+{ //counts characters and throws them away
+public:
+  unsigned int chars;
+  size_t write(uint8_t c) { chars++; return 1; }
+};
+
+void BenchReport(const __FlashStringHelper *name, int tag, unsigned int calls)
+{ //tag, if there is one, goes on the end of the name
+  Serial.print(F("BENCH "));
+  Serial.print(name);
+  if(tag) Serial.print(tag);
+  Serial.print(' ');
+  Serial.print(calls);
+  Serial.print(' ');
+  Serial.println(benchTotal);
+  Serial.flush(); //so the uart interrupt isn't timed next
+  benchTotal = 0;
+}
+
+void Benchmark()
+{
+  const unsigned int calls = 200;
+  double bInput = 100, bOutput = 0, bSetpoint = 110;
+
+  PID bPid(&bInput, &bOutput, &bSetpoint, 2, 0.5, 2, DIRECT);
+  bPid.SetSampleTime(1);
+  bPid.SetOutputLimits(0, 100);
+  bPid.SetAntiWindup(AW_BACKCALC, trackingGain);
+  bPid.SetDerivativeFilter(filterN);
+  bPid.SetMode(AUTOMATIC);
+  for(unsigned int i=0;i<calls;i++)
+  {
+    delay(1); //Compute only does anything once a sample time has passed
+    bInput = 100 + (i & 7);
+    benchStart = micros();
+    bPid.Compute();
+    benchTotal += micros() - benchStart;
+  }
+  BenchReport(F("pid_compute"), 0, calls);
+
+  //the peak search is what grows with the lookback, so do the
+  //smallest, the largest, and a couple in between
+  const int lookbacks[] = {2, 12, 24, 100};
+  const unsigned int tuneCalls = 10; //up to a second between calls
+  for(byte n=0;n<4;n++)
+  {
+    PID_ATune bTune(&bInput, &bOutput);
+    bTune.SetLookbackSec(lookbacks[n]);
+    bTune.SetNoiseBand(1);
+    bTune.SetOutputStep(10);
+    for(unsigned int i=0;i<tuneCalls;i++)
+    {
+      delay(lookbacks[n]<25 ? 250 : lookbacks[n]*10); //sample time
+      bInput = 100 + (i & 3) - 2;
+      benchStart = micros();
+      bTune.Runtime();
+      benchTotal += micros() - benchStart;
+    }
+    BenchReport(F("atune_runtime_lb"), lookbacks[n], tuneCalls);
+  }
+
+#if defined(TEMP_INPUT_V110) || defined(TEMP_INPUT_V120)
+  for(unsigned int i=0;i<calls;i++)
+  {
+    benchStart = micros();
+    benchSink = inputCard.ReadThermistor(100 + i*4);
+    benchTotal += micros() - benchStart;
+  }
+  BenchReport(F("thermistor_temp"), 0, calls);
+#endif
+
+#ifdef TEMP_INPUT_V120
+  for(unsigned int i=0;i<calls;i++)
+  {
+    benchStart = micros();
+    benchSink = inputCard.thermocouple.readThermocouple(CELSIUS);
+    benchTotal += micros() - benchStart;
+  }
+  BenchReport(F("max31855_read"), 0, calls);
+#endif
+
+  //includes the lcd writes, which is most of it on the controller
+  double sp = setpoint;
+  for(unsigned int i=0;i<calls;i++)
+  {
+    setpoint = 0.37 * i - 20;
+    benchStart = micros();
+    drawItem(0, false, 4);
+    benchTotal += micros() - benchStart;
+  }
+  setpoint = sp;
+  BenchReport(F("draw_item"), 0, calls);
+
+  //the stock float printing against FormatNumber.  these report
+  //characters rather than calls, for characters per second
+  BenchPrint bPrint;
+  bPrint.chars = 0;
+  for(unsigned int i=0;i<calls;i++)
+  {
+    double v = 1.37 * i - 50;
+    benchStart = micros();
+    bPrint.print(v);
+    benchTotal += micros() - benchStart;
+  }
+  BenchReport(F("format_stock_chars"), 0, bPrint.chars);
+  bPrint.chars = 0;
+  for(unsigned int i=0;i<calls;i++)
+  {
+    double v = 1.37 * i - 50;
+    benchStart = micros();
+    PrintNumber(bPrint, v);
+    benchTotal += micros() - benchStart;
+  }
+  BenchReport(F("format_fixed_chars"), 0, bPrint.chars);
+
+  //one DASH line fits in the transmit buffer, so this is the formatting
+  //rather than the wait for the uart.  the startup messages go first
+  SerialSend();
+  Serial.flush();
+  for(unsigned int i=0;i<calls/10;i++)
+  {
+    sendDash = true;
+    benchStart = micros();
+    SerialSend();
+    benchTotal += micros() - benchStart;
+    Serial.flush();
+  }
+  BenchReport(F("serial_send_dash"), 0, calls/10);
+  Serial.println(F("BENCH_DN"));
+}
+#endif /*USE_BENCHMARK*/
+
 
 
 void setup()
@@ -120,7 +600,10 @@ void setup()
   delay(1000);
 
   initializeEEPROM();
-
+  StallRecord();
+  pinMode(txEnablePin, OUTPUT);
+  digitalWrite(txEnablePin, LOW);
+  modbus.SetTxEnable(txEnablePin);
 
 
 #ifdef USE_SIMULATION
@@ -131,10 +614,18 @@ void setup()
   InitializeOutputCard();
 #endif
   myPID.SetSampleTime(1000);
-  myPID.SetOutputLimits(0, 100);
+  myPID.SetOutputLimits(OutputCardMin(), 100);
   myPID.SetTunings(kp, ki, kd);
   myPID.SetControllerDirection(ctrlDirection);
+  myPID.SetAntiWindup(AW_BACKCALC, trackingGain);
+  myPID.SetDerivativeFilter(filterN);
+  myPID.SetSetpointWeights(weightB, weightC);
   myPID.SetMode(modeIndex);
+  ProfileBoot();
+#ifdef USE_BENCHMARK
+  Benchmark();
+#endif
+  WatchdogStart();
 }
 
 byte editDepth=0;
@@ -144,28 +635,36 @@ void loop()
 
   if(now >= buttonTime)
   {
-    switch(button.get())
+    button.sample();
+    button_t pressed;
+    buttonEvent_t event;
+    while((pressed = button.get(&event)) != BUTTON_NONE)
     {
-    case BUTTON_NONE:
-      break;
+      switch(pressed)
+      {
+      case BUTTON_RETURN:
+        if(event==BUTTON_LONG) home();
+        else back();
+        break;
 
-    case BUTTON_RETURN:
-      back();
-      break;
+      case BUTTON_UP:      
+        updown(true);
+        break;
 
-    case BUTTON_UP:      
-      updown(true);
-      break;
+      case BUTTON_DOWN:
+        updown(false);
+        break;
 
-    case BUTTON_DOWN:
-      updown(false);
-      break;
+      case BUTTON_OK:
+        if(event==BUTTON_PRESS) ok();
+        break;
 
-    case BUTTON_OK:
-      ok();
-      break;
+      default:
+        break;
+      }
     }
-    buttonTime += 50;
+    buttonTime += 10;
+    stageTime[STAGE_BUTTON] = now;
   }
 
   bool doIO = now >= ioTime;
@@ -173,41 +672,75 @@ void loop()
   if(doIO)
   { 
     ioTime+=250;
+    stageTime[STAGE_IO] = now;
 #ifdef USE_SIMULATION
     DoModel();
     pidInput = input;
+#else
+#ifdef USE_REPLAY
+    input = ReplayInput(); //recorded samples stand in for the input card (see replay/)
 #else
     input =  ReadInputFromCard();
+#endif /*USE_REPLAY*/
     inputOk = !isnan(input);
     if(inputOk)pidInput = input;
 
 #endif /*USE_SIMULATION*/
+    if(smithOn && !tuning && inputOk) predictor.Compute(); //corrects pidInput
+    CheckSafety();
+    AlarmRunTime();
   }
   
 
   if(tuning)
   {
-    byte val = (aTune.Runtime());
+    int val = aTuneMethod==1 ? sTune.Runtime() : aTune.Runtime();
 
     if(val != 0)
     {
       tuning = false;
     }
 
-    if(!tuning)
+    if(!tuning && val<0)
+    { //the step test gave up; leave the tunings alone
+      AutoTuneHelper(false);
+    }
+    else if(!tuning)
     { 
       // We're done, set the tuning parameters
-      kp = aTune.GetKp();
-      ki = aTune.GetKi();
-      kd = aTune.GetKd();
+      if(aTuneMethod==1)
+      {
+        kp = sTune.GetKp();
+        ki = sTune.GetKi();
+        kd = sTune.GetKd();
+      }
+      else
+      {
+        kp = aTune.GetKp();
+        ki = aTune.GetKi();
+        kd = aTune.GetKd();
+      }
       myPID.SetTunings(kp, ki, kd);
       AutoTuneHelper(false);
       EEPROMBackupTunings();
+      GainStepFromATune();
+      if(aTuneMethod==1)
+      { //the step test measures the model directly
+        predictor.SetModel(sTune.GetGain(), sTune.GetTimeConstant(), sTune.GetDeadTime());
+        EEPROMBackupSmith();
+        sendSmith = true;
+      }
+      else if(predictor.SetModelFromRelay(aTune.GetKu(), aTune.GetPu()))
+      {
+        EEPROMBackupSmith();
+        sendSmith = true;
+      }
     }
   }
   else
   {
     if(runningProfile) ProfileRunTime();
+    if(doIO) ApplyGainSchedule();
     //allow the pid to compute if necessary
     if(inputOk) myPID.Compute();
   }
@@ -219,183 +752,276 @@ void loop()
   if(doIO)
   {
     //send the output
+    if(tripCode!=TRIP_NONE)
+    {
+      output = 0;  // a trip holds the output off until it's cleared
+      myPID.Track(output);
+    }
 #ifdef USE_SIMULATION
-    theta[29] = output;
+    // Cycle the dead time
+    theta[thetaHead] = output;
+    if(++thetaHead==30) thetaHead = 0;
 #else
-    if(!inputOk) output = 0;  // Ensure output is zero when input is invalid
+    if(!inputOk)
+    {
+      output = 0;  // Ensure output is zero when input is invalid
+      myPID.Track(output); //and let the integral follow so recovery is bumpless
+    }
     // Send to output card
     WriteToOutputCard(output);
 #endif /*USE_SIMULATION*/  
 
-
-
+    LogRunTime();
+    AdaptRunTime();
+    ReportRunTime();
   }
 
   if(now>lcdTime)
   {
     drawLCD();
     lcdTime+=250; 
+    stageTime[STAGE_LCD] = now;
   }
+  if(serialProtocol==PROTOCOL_MODBUS && modbus.Poll()) ModbusCommit();
+  else if(serialProtocol==PROTOCOL_BUS) BusPoll();
+  else if(serialProtocol==PROTOCOL_LEGACY) SerialPoll();
   if(millis() > serialTime)
   {
     //if(receivingProfile && (now-profReceiveStart)>profReceiveTimeout) receivingProfile = false;
-    SerialReceive();
-    SerialSend();
+    MemoryScan();
+    if(serialProtocol==PROTOCOL_LEGACY)
+    {
+      SerialReceive();
+      if(serialProtocol==PROTOCOL_LEGACY) SerialSend(); //unless it just switched to modbus
+    }
     serialTime += 500;
+    stageTime[STAGE_SERIAL] = now;
+  }
+  Supervise();
+}
+
+
+/********************************************
+ * Menus
+ * every line the lcd can show is described by an
+ * entry in menuItems[], and a menu is just a list
+ * of entries.  drawing, editing and saving all
+ * work from the descriptions, so a new setting
+ * only needs an entry here and a place in a menu.
+ * values are edited a digit at a time, so they're
+ * shown with 1 or 2 decimals.  a changed setting
+ * is put to use, and backed up, once its menu is
+ * left; ITEM_LIVE ones take effect right away.
+ ********************************************/
+const byte TYPE_NAV=0;
+const byte TYPE_VAL=1;
+const byte TYPE_OPT=2;
+
+const byte ITEM_DEC = 3;     //decimals shown, in the low bits
+const byte ITEM_RO = 4;      //display only
+const byte ITEM_MANUAL = 8;  //only editable in manual
+const byte ITEM_IDLE = 16;   //not editable while autotuning
+const byte ITEM_LIVE = 32;   //applied as soon as it changes
+const byte ITEM_GAIN = 64;   //a fixed tuning: while a gain schedule is in use the
+                             //tuning in use is shown instead, and can't be edited
+
+//what a nav item leads to: a menu number, or one of these
+const byte NAV_TUNE = 0x80, NAV_PROFILE = 0x81;
+//the settings a value or option belongs to, for applying and backing up
+const byte GROUP_DASH = 1, GROUP_TUNE = 2, GROUP_OUTPUT = 4, GROUP_ALARM = 8;
+
+struct MenuItem
+{
+  byte type;
+  char icon;
+  byte flags;
+  byte link;              //nav: where it leads.  value or option: its group
+  void *var;              //value: a double.  option: a byte, 0 or 1
+  float minimum, maximum;
+  const char *label[2];   //nav: its label.  option: the text for 0 and 1
+};
+
+enum { M_DASH, M_CONFIG, M_ALARMS, M_ATUNE, M_PROFILE,
+       M_SETPOINT, M_INPUT, M_OUTPUT, M_MODE,
+       M_KP, M_KI, M_KD, M_DIRECTION, M_FILTER, M_WEIGHTB, M_WEIGHTC,
+       M_DEVHIGH, M_DEVLOW, M_RATE, M_OVERSHOOT, M_HORIZON, M_HYST,
+       M_WINDOW };
+
+const char lblDash[] PROGMEM = "DashBrd";
+const char lblConfig[] PROGMEM = "Config ";
+const char lblAlarms[] PROGMEM = "Alarms ";
+const char lblMan[] PROGMEM = "Man  ";
+const char lblAuto[] PROGMEM = "Auto ";
+const char lblDirect[] PROGMEM = "Direc";
+const char lblReverse[] PROGMEM = "Rever";
+
+const MenuItem menuItems[] PROGMEM = {
+  //type    icon flags                   link          var              min     max
+  { TYPE_NAV, ' ', 0,                    1,            0,               0,      0,      { lblDash, 0 } },
+  { TYPE_NAV, ' ', 0,                    2,            0,               0,      0,      { lblConfig, 0 } },
+  { TYPE_NAV, ' ', 0,                    3,            0,               0,      0,      { lblAlarms, 0 } },
+  { TYPE_NAV, ' ', 0,                    NAV_TUNE,     0,               0,      0,      { 0, 0 } },
+  { TYPE_NAV, ' ', 0,                    NAV_PROFILE,  0,               0,      0,      { 0, 0 } },
+  { TYPE_VAL, 'S', 1,                    GROUP_DASH,   &setpoint,       -999.9, 999.9,  { 0, 0 } },
+  { TYPE_VAL, 'I', 1|ITEM_RO,            0,            &input,          -999.9, 999.9,  { 0, 0 } },
+  { TYPE_VAL, 'O', 1|ITEM_MANUAL|ITEM_IDLE, GROUP_DASH, &output,        -999.9, 999.9,  { 0, 0 } },
+  { TYPE_OPT, 'M', ITEM_IDLE|ITEM_LIVE,  GROUP_DASH,   &modeIndex,      0,      1,      { lblMan, lblAuto } },
+  { TYPE_VAL, 'P', 2|ITEM_GAIN,          GROUP_TUNE,   &kp,             0,      99.99,  { 0, 0 } },
+  { TYPE_VAL, 'I', 2|ITEM_GAIN,          GROUP_TUNE,   &ki,             0,      99.99,  { 0, 0 } },
+  { TYPE_VAL, 'D', 2|ITEM_GAIN,          GROUP_TUNE,   &kd,             0,      99.99,  { 0, 0 } },
+  { TYPE_OPT, 'A', 0,                    GROUP_TUNE,   &ctrlDirection,  0,      1,      { lblDirect, lblReverse } },
+  { TYPE_VAL, 'N', 1,                    GROUP_TUNE,   &filterN,        0,      99.9,   { 0, 0 } },
+  { TYPE_VAL, 'b', 2,                    GROUP_TUNE,   &weightB,        0,      1,      { 0, 0 } },
+  { TYPE_VAL, 'c', 2,                    GROUP_TUNE,   &weightC,        0,      1,      { 0, 0 } },
+  { TYPE_VAL, 'H', 1,                    GROUP_ALARM,  &alarmDevHigh,   0,      999.9,  { 0, 0 } },
+  { TYPE_VAL, 'L', 1,                    GROUP_ALARM,  &alarmDevLow,    0,      999.9,  { 0, 0 } },
+  { TYPE_VAL, 'R', 1,                    GROUP_ALARM,  &alarmRate,      0,      999.9,  { 0, 0 } },
+  { TYPE_VAL, 'O', 1,                    GROUP_ALARM,  &alarmOvershoot, 0,      999.9,  { 0, 0 } },
+  { TYPE_VAL, 'T', 1,                    GROUP_ALARM,  &alarmHorizon,   0,      999.9,  { 0, 0 } },
+  { TYPE_VAL, 'h', 1,                    GROUP_ALARM,  &alarmHyst,      0,      99.9,   { 0, 0 } },
+#if defined(DIGITAL_OUTPUT_V120) || defined(DIGITAL_OUTPUT_V150)
+  { TYPE_VAL, 'W', 1,                    GROUP_OUTPUT, &outputCard.windowSec, 0.5,    999.9,  { 0, 0 } },
+#endif
+};
+
+const byte MENU_END = 0xFF;
+const byte mMenu[][9] PROGMEM = {
+  { M_DASH, M_CONFIG, M_ALARMS, M_ATUNE, M_PROFILE, MENU_END },                     //main
+  { M_SETPOINT, M_INPUT, M_OUTPUT, M_MODE, MENU_END },                              //dashboard
+  { M_KP, M_KI, M_KD, M_DIRECTION, M_FILTER, M_WEIGHTB, M_WEIGHTC,
+#if defined(DIGITAL_OUTPUT_V120) || defined(DIGITAL_OUTPUT_V150)
+    M_WINDOW,
+#endif
+    MENU_END },                                                                     //config
+  { M_DEVHIGH, M_DEVLOW, M_RATE, M_OVERSHOOT, M_HORIZON, M_HYST, MENU_END }};      //alarms
+
+byte changeGroups = 0; //groups edited since the menu was entered
+
+byte MenuLength(byte menu)
+{
+  byte n = 0;
+  while(n<sizeof(mMenu[0]) && pgm_read_byte(&mMenu[menu][n])!=MENU_END) n++;
+  return n;
+}
+
+bool MenuEditable(byte index)
+{
+  MenuItem item;
+  memcpy_P(&item, &menuItems[index], sizeof(MenuItem));
+  if(item.type==TYPE_NAV || (item.flags & ITEM_RO)) return false;
+  if((item.flags & ITEM_IDLE) && tuning) return false;
+  if((item.flags & ITEM_MANUAL) && modeIndex!=0) return false;
+  if((item.flags & ITEM_GAIN) && GainScheduleOn()) return false;
+  return true;
+}
+
+// the tuning in use, for an ITEM_GAIN entry
+double MenuGain(byte index)
+{
+  if(index==M_KP) return myPID.GetKp();
+  if(index==M_KI) return myPID.GetKi();
+  return myPID.GetKd();
+}
+
+void MenuApply(byte groups)
+{
+  if(groups & GROUP_DASH) myPID.SetMode(modeIndex);
+  if(groups & GROUP_TUNE)
+  {
+    myPID.SetTunings(kp,ki,kd);
+    myPID.SetControllerDirection(ctrlDirection);
+    myPID.SetDerivativeFilter(filterN);
+    myPID.SetSetpointWeights(weightB, weightC);
   }
+#if defined(DIGITAL_OUTPUT_V120) || defined(DIGITAL_OUTPUT_V150)
+  if(groups & GROUP_OUTPUT) outputCard.SetWindow(outputCard.windowSec);
+#endif
 }
 
+void MenuSave(byte groups)
+{
+  if(groups & GROUP_DASH) EEPROMBackupDash();
+  if(groups & GROUP_TUNE) EEPROMBackupTunings();
+  if(groups & GROUP_OUTPUT) EEPROMBackupOutputParams(eepromOutputOffset);
+  if(groups & GROUP_ALARM) EEPROMBackupAlarm();
+}
 
 void drawLCD()
 {
   boolean highlightFirst= (mDrawIndex==mIndex);
-  drawItem(0,highlightFirst, mMenu[curMenu][mDrawIndex]);
-  drawItem(1,!highlightFirst, mMenu[curMenu][mDrawIndex+1]);  
+  drawItem(0,highlightFirst, pgm_read_byte(&mMenu[curMenu][mDrawIndex]));
+  drawItem(1,!highlightFirst, pgm_read_byte(&mMenu[curMenu][mDrawIndex+1]));  
   if(editing) lcd.setCursor(editDepth, highlightFirst?0:1);
 }
 
 void drawItem(byte row, boolean highlight, byte index)
 {
-  char buffer[7];
+  char buffer[8];
   lcd.setCursor(0,row);
-  double val=0;
-  int dec=0;
-  int num=0;
-  char icon=' ';
-  boolean isNeg = false;
-  boolean didneg = false;
-  byte decSpot = 0;
+  MenuItem item;
+  memcpy_P(&item, &menuItems[index], sizeof(MenuItem));
   boolean edit = editing && highlightedIndex==index;
-  boolean canEdit=!tuning;
-  switch(getMenuType(index))
+  switch(item.type)
   {
   case TYPE_NAV:
     lcd.print(highlight? '>':' ');
-    switch(index)
+    if(item.link==NAV_TUNE)
     {
-    case 0: 
-      lcd.print(F("DashBrd")); 
-      break;
-    case 1: 
-      lcd.print(F("Config ")); 
-      break;
-    case 2: 
-      lcd.print(tuning ? F("Cancel ") : F("ATune  ")); 
-      break;
-    case 3:
-      if(runningProfile)lcd.print(F("Cancel "));
+      if(tuning) lcd.print(F("Cancel "));
+      else lcd.print(aTuneMethod==1 ? F("STune  ") : F("ATune  ")); 
+    }
+    else if(item.link==NAV_PROFILE)
+    {
+      if(profileHeld)lcd.print(F("Resume "));
+      else if(runningProfile)lcd.print(F("Cancel "));
       else lcd.print(profname);
-      break;
-    default: 
-      return;
     }
-
+    else lcd.print((const __FlashStringHelper*)item.label[0]);
     break;
   case TYPE_VAL:
-
-    switch(index)
-    {
-    case 4: 
-      val = setpoint; 
-      dec=1; 
-      icon='S'; 
-      break;
-    case 5: 
-      val = input; 
-      dec=1; 
-      icon='I'; 
-      canEdit=false;
-      break;
-    case 6: 
-      val = output; 
-      dec=1; 
-      icon='O'; 
-      canEdit = (modeIndex==0);
-      break;
-    case 8: 
-      val = kp; 
-      dec=2; 
-      icon='P'; 
-      break;
-    case 9: 
-      val = ki; 
-      dec=2; 
-      icon='I'; 
-      break ;
-    case 10: 
-      val = kd; 
-      dec=2; 
-      icon='D'; 
-      break ;
-
-    default: 
-      return;
-    }
-    lcd.print(edit? '[' : (highlight ? (canEdit ? '>':'|') : 
+    lcd.print(edit? '[' : (highlight ? (MenuEditable(index) ? '>':'|') : 
     ' '));
     
-    if(isnan(val))
-    { //display an error
-      lcd.print(icon);
+    lcd.print(item.icon);
+    if(FormatNumber(buffer, (item.flags & ITEM_GAIN) && GainScheduleOn() ? MenuGain(index) : *(double*)item.var,
+      item.flags & ITEM_DEC, 6)==0)
+    { //display an error (NAN, or too big to show)
       lcd.print( now % 2000<1000 ? F(" Error"):F("      ")); 
       return;
     }
-    
-    for(int i=0;i<dec;i++) val*=10;
-    
-    num = (int)round(val);
-    buffer[0] = icon;
-    isNeg = num<0;
-    if(isNeg) num = 0 - num;
-    didneg = false;
-    decSpot = 6-dec;
-    if(decSpot==6)decSpot=7;
-    for(byte i=6; i>=1;i--)
-    {
-      if(i==decSpot)buffer[i] = '.';
-      else {
-        if(num==0)
-        {
-          if(i>=decSpot-1) buffer[i]='0';
-          else if (isNeg && !didneg)
-          {
-            buffer[i]='-';
-            didneg=true;
-          }
-          else buffer[i]=' ';
-        }
-        else {
-          buffer[i] = num%10+48;
-          num/=10;
-        }
-      }
-    }     
     lcd.print(buffer);
     break;
   case TYPE_OPT: 
-
     lcd.print(edit ? '[': (highlight? '>':' '));    
-    switch(index)
-    {
-    case 7:    
-      lcd.print(modeIndex==0 ? F("M Man  "):F("M Auto ")); 
-      break;
-    case 11://12: 
-
-      lcd.print(ctrlDirection==0 ? F("A Direc"):F("A Rever")); 
-      break;
-    }
-
+    lcd.print(item.icon);
+    lcd.print(' ');
+    lcd.print((const __FlashStringHelper*)item.label[*(byte*)item.var ? 1 : 0]);
     break;
   default: 
     return;
   }
 
   //indication of altered state
-  if(highlight && (tuning || runningProfile))
+  if(highlight && (tuning || runningProfile || tripCode!=TRIP_NONE || AlarmState()))
   {
     //should we blip?
-    if(tuning)
+    if(tripCode!=TRIP_NONE)
+    {
+      if(now % 1000 <500)
+      {
+        lcd.setCursor(0,row);
+        lcd.print('!'); 
+      }
+    }
+    else if(AlarmState())
+    {
+      if(now % 1000 <500)
+      {
+        lcd.setCursor(0,row);
+        lcd.print('A'); 
+      }
+    }
+    else if(tuning)
     { 
       if(now % 1500 <500)
       {
@@ -422,58 +1048,17 @@ void drawItem(byte row, boolean highlight, byte index)
   }
 }
 
-byte getValDec(byte index)
-{       
-  switch(index)
-  {
-  case 4: 
-  case 5: 
-  case 6: 
-  //case 11: 
-    return 1;
-  case 8: 
-  case 9: 
-  case 10: 
-  default:
-    return 2;
-  }
-}
-byte getMenuType(byte index)
-{
-  switch(index)
-  {
-  case 0:
-  case 1:
-  case 2:
-  case 3:
-    return TYPE_NAV;
-  case 4: 
-  case 5: 
-  case 6: 
-  case 8: 
-  case 9: 
-  case 10: 
-  //case 11:
-    return TYPE_VAL;
-  case 7:
-  case 11: //12:
-    return TYPE_OPT;
-  default: 
-    return 255;
-  }
-}
-
-boolean changeflag=false;
-
 void back()
 {
+  MenuItem item;
+  memcpy_P(&item, &menuItems[highlightedIndex], sizeof(MenuItem));
   if(editing)
   { //decrease the depth and stop editing if required
 
     editDepth--;
-    if(getMenuType(highlightedIndex)==TYPE_VAL)
+    if(item.type==TYPE_VAL)
     {
-      if(editDepth==7-getValDec(highlightedIndex))editDepth--; //skip the decimal  
+      if(editDepth==7-(item.flags & ITEM_DEC))editDepth--; //skip the decimal  
     }
     if(editDepth<3)
     {
@@ -485,69 +1070,31 @@ void back()
   else
   { //if not editing return to previous menu. currently this is always main
 
-
-    //depending on which menu we're coming back from, we may need to write to the eeprom
-    if(changeflag)
+    //put whatever was changed in the menu to use, and into the eeprom
+    if(changeGroups)
     {
-      if(curMenu==1)
-      { 
-        EEPROMBackupDash();
-      }
-      else if(curMenu==2) //tunings may have changed
-      {
-        EEPROMBackupTunings();
-        myPID.SetTunings(kp,ki,kd);
-        myPID.SetControllerDirection(ctrlDirection);
-      }
-      changeflag=false;
+      MenuApply(changeGroups);
+      MenuSave(changeGroups);
+      changeGroups=0;
     }
     if(curMenu!=0)
-    { 
-      highlightedIndex = curMenu-1; //make sure the arrow is on the menu they were in
-      mIndex=curMenu-1;
+    { //make sure the arrow is on the menu they were in
+      byte n = MenuLength(0);
+      for(mIndex=0;mIndex<n-1;mIndex++)
+      {
+        memcpy_P(&item, &menuItems[pgm_read_byte(&mMenu[0][mIndex])], sizeof(MenuItem));
+        if(item.link==curMenu) break;
+      }
+      highlightedIndex = pgm_read_byte(&mMenu[0][mIndex]);
+      mDrawIndex = mIndex<n-1 ? mIndex : mIndex-1;
       curMenu=0;
-      mDrawIndex=0;
-
     }
   }
 }
 
-
-
-double getValMin(byte index)
-{
-  switch(index)
-  {
-  case 4: 
-  case 5: 
-  case 6: 
-//  case 11: 
-    return -999.9;
-  case 8: 
-  case 9: 
-  case 10: 
-  default:
-    return 0;
-  }
-}
-
-
-double getValMax(byte index)
-{
-  switch(index)
-  {
-  case 4: 
-  case 5: 
-  case 6: 
-  //case 11: 
-    return 999.9;
-  case 8: 
-  case 9: 
-  case 10: 
-  default:
-    return 99.99;
-  } 
-
+void home()
+{ //holding return backs out of any editing and menu, saving as it goes
+  while(editing || curMenu!=0) back();
 }
 
 void updown(bool up)
@@ -555,62 +1102,31 @@ void updown(bool up)
 
   if(editing)
   {
-    changeflag = true;
+    MenuItem item;
+    memcpy_P(&item, &menuItems[highlightedIndex], sizeof(MenuItem));
     byte decdepth;
-    double adder;
-    switch(getMenuType(highlightedIndex))
+    double adder, *val;
+    switch(item.type)
     {
     case TYPE_VAL:
-      decdepth = 7 - getValDec(highlightedIndex);
+      decdepth = 7 - (item.flags & ITEM_DEC);
       adder=1;
       if(editDepth<decdepth-1)for(int i=editDepth;i<decdepth-1;i++)adder*=10;
       else if(editDepth>decdepth)for(int i=decdepth;i<editDepth;i++)adder/=10;
 
       if(!up)adder = 0-adder;
 
-      double *val, minimum, maximum;
-      switch(highlightedIndex)
-      {
-      case 4: 
-        val=&setpoint; 
-        break;
-      case 6:  
-        val=&output; 
-        break;
-      case 8:  
-        val=&kp; 
-        break;
-      case 9:  
-        val=&ki; 
-        break;
-      case 10:  
-        val=&kd; 
-        break;
-      }
-      
-      minimum = getValMin(highlightedIndex);
-      maximum = getValMax(highlightedIndex);
+      val = (double*)item.var;
       (*val)+=adder;
-      if((*val)>maximum)(*val)=maximum;
-      else if((*val)<minimum)(*val)=minimum;
+      if((*val)>item.maximum)(*val)=item.maximum;
+      else if((*val)<item.minimum)(*val)=item.minimum;
       break; 
     case TYPE_OPT:
-      switch(highlightedIndex)
-      {
-      case 7:
-        modeIndex= (modeIndex==0?1:0);
-        /*mode change code*/
-        myPID.SetMode(modeIndex);
-        break;
-      case 11://12:
-        ctrlDirection = (ctrlDirection==0?1:0); 
-        Serial.println(ctrlDirection);
-        break;
-      }
-
+      *(byte*)item.var = (*(byte*)item.var==0?1:0);
       break;
     }
-
+    if(item.flags & ITEM_LIVE) MenuApply(item.link);
+    changeGroups |= item.link;
   }
   else
   {
@@ -624,98 +1140,79 @@ void updown(bool up)
     }
     else
     {
-      byte limit = 3;// (curMenu==2 ? 4 : 3); 
-      if(mIndex<limit)
+      if(mIndex<MenuLength(curMenu)-1)
       {
         mDrawIndex =mIndex;
         mIndex++;
       }
     }
-    highlightedIndex = mMenu[curMenu][mIndex];
+    highlightedIndex = pgm_read_byte(&mMenu[curMenu][mIndex]);
   }
 }
 
-
-
-
-
 void ok()
 {
+  MenuItem item;
+  memcpy_P(&item, &menuItems[highlightedIndex], sizeof(MenuItem));
   if(editing)
   {
-    byte dec = getValDec(highlightedIndex);
-    if(getMenuType(highlightedIndex) == TYPE_VAL &&(editDepth<6 || (editDepth==6 && dec!=1)))
+    byte dec = item.flags & ITEM_DEC;
+    if(item.type == TYPE_VAL &&(editDepth<6 || (editDepth==6 && dec!=1)))
     {
       editDepth++;
       if(editDepth==7-dec)editDepth++; //skip the decimal
     }
   }
-  else
+  else if(item.type==TYPE_NAV)
   {
-
-    switch(highlightedIndex)
+    if(item.link==NAV_TUNE) changeAutoTune();
+    else if(item.link==NAV_PROFILE)
     {
-    case 0: 
-      curMenu=1;
-      mDrawIndex=0;
-      mIndex=0; 
-      highlightedIndex = 4; //setpoint
-      changeflag = false;
-      break;
-    case 1: 
-      curMenu=2;
-      mDrawIndex=0;
-      mIndex=0; 
-      highlightedIndex = 8; //kp
-      changeflag = false;
-      break;
-    case 2: 
-      changeAutoTune();/*autotune code*/
-      break;
-    case 3: 
-      if(runningProfile)StopProfile();
+      if(runningProfile && !profileHeld)StopProfile();
       else StartProfile();
-
-      break;
-    case 5: /*nothing for input*/
-      break;
-    case 6: 
-      if(modeIndex==0 && !tuning) editing=true; 
-      break; //output
-    case 4: //setpoint
-    case 8: //kp
-    case 9: //ki
-    case 10: //kd
-//    case 11: //windowsize
-    case 11: //12: //direction
-      editing=true;
-      break; //verify this is correct
-    case 7: 
-      if(!tuning) editing=true; 
-      break; //mode
     }
-    if(editing)
+    else
     {
-      editDepth=3;
-      lcd.cursor();
+      curMenu=item.link;
+      mDrawIndex=0;
+      mIndex=0; 
+      highlightedIndex = pgm_read_byte(&mMenu[curMenu][0]);
+      changeGroups = 0;
     }
   }
+  else if(MenuEditable(highlightedIndex))
+  {
+    editing=true;
+    editDepth=3;
+    lcd.cursor();
+  }
 }
 
+
 void changeAutoTune()
 {
   if(!tuning)
   {
     //initiate autotune
     AutoTuneHelper(true);
-    aTune.SetNoiseBand(aTuneNoise);
-    aTune.SetOutputStep(aTuneStep);
-    aTune.SetLookbackSec((int)aTuneLookBack);
+    if(aTuneMethod==1)
+    {
+      sTune.SetNoiseBand(aTuneNoise);
+      sTune.SetOutputStep(aTuneStep);
+      sTune.SetLookbackSec((int)aTuneLookBack);
+    }
+    else
+    {
+      aTune.SetNoiseBand(aTuneNoise);
+      aTune.SetOutputStep(aTuneStep);
+      aTune.SetLookbackSec((int)aTuneLookBack);
+    }
     tuning = true;
   }
   else
   { //cancel autotune
     aTune.Cancel();
+    sTune.Cancel();
     tuning = false;
     AutoTuneHelper(false);
   }
@@ -743,27 +1240,36 @@ void AutoTuneHelper(boolean start)
 
 void StartProfile()
 {
-  if(!runningProfile)
+  if(profileHeld)
+  { //carry on from where the power cut left it
+    profileHeld = false;
+    ProfileSetElapsed(heldElapsed);
+    sendResume = true;
+  }
+  else if(!runningProfile && ProfileComplete())
   {
     //initialize profle
     curProfStep=0;
     runningProfile = true;
     calcNextProf();
+    if(runningProfile) ProfileCheckpoint();
   }
 }
 void StopProfile()
 {
   if(runningProfile)
   {
+    profileHeld = false;
     curProfStep=nProfSteps;
     calcNextProf(); //runningProfile will be set to false in here
+    ProfileCheckpointClear();
   } 
 }
 
 
 void ProfileRunTime()
 {
-  if(tuning || !runningProfile) return;
+  if(tuning || !runningProfile || profileHeld) return;
   
 
 
@@ -809,7 +1315,7 @@ void ProfileRunTime()
     if(now<helperTime)digitalWrite(buzzerPin,HIGH);
     else 
     {
-       digitalWrite(buzzerPin,LOW);
+       digitalWrite(buzzerPin,alarmSounding ? HIGH : LOW);
        gotonext=true;
     }
   }
@@ -827,7 +1333,10 @@ void ProfileRunTime()
   {
     curProfStep++;
     calcNextProf();
+    if(runningProfile) ProfileCheckpoint();
+    else ProfileCheckpointClear();
   }
+  else if(now-checkpointTime >= checkpointInterval) ProfileCheckpoint();
 }
 
 void calcNextProf()
@@ -839,9 +1348,9 @@ void calcNextProf()
   }
   else
   { 
-    curType = proftypes[curProfStep];
-    curVal = profvals[curProfStep];
-    curTime = proftimes[curProfStep];
+    curType = EEPROM.read(eepromProfileOffset + 8 + curProfStep);
+    EEPROM_readAnything(eepromProfileOffset + 24 + 4*curProfStep, curVal);
+    EEPROM_readAnything(eepromProfileOffset + 84 + 4*curProfStep, curTime);
 
   }
   if(curType==1) //ramp
@@ -875,33 +1384,183 @@ void calcNextProf()
   { //we're done 
     runningProfile=false;
     curProfStep=0;
-    Serial.println("P_DN");
-    digitalWrite(buzzerPin,LOW);
+    if(serialProtocol==PROTOCOL_LEGACY) Serial.println(F("P_DN"));
+    digitalWrite(buzzerPin,alarmSounding ? HIGH : LOW);
   } 
-  else
+  else if(serialProtocol==PROTOCOL_LEGACY)
   {
-    Serial.print("P_STP ");
+    Serial.print(F("P_STP "));
     Serial.print(int(curProfStep));
-    Serial.print(" ");
+    Serial.print(' ');
     Serial.print(int(curType));
-    Serial.print(" ");
-    Serial.print((curVal));
-    Serial.print(" ");
+    Serial.print(' ');
+    PrintNumber(Serial, curVal);
+    Serial.print(' ');
     Serial.println((curTime));
   }
 
 }
 
+/********************************************
+ * Profile checkpoints
+ * while a profile runs, where it's got to (the
+ * step, the time into it, the ramp's starting
+ * point and the setpoint) is saved so that it can
+ * be picked up again after a power cut: at the
+ * start of each step and every 15 minutes into a
+ * long one.  the EEPROM only takes 100,000 writes
+ * a cell, so the checkpoints go round 4 slots,
+ * each with a sequence number to tell the latest
+ * and a check byte to spot one that was cut off
+ * half written, and only the bytes that changed
+ * are written.  running flat out, a slot is
+ * written once an hour: under 9000 times a year.
+ * a profile that ends or is stopped leaves a
+ * checkpoint saying so.  at power up the policy
+ * decides what happens to a profile that was cut
+ * off: abort it (as before; nothing is written at
+ * all under this policy), hold it at the
+ * checkpoint's setpoint until it's started again,
+ * or resume it straight away.  the time the power
+ * was off doesn't count, and up to 15 minutes of
+ * the step is repeated.
+ ********************************************/
+int checkpointOffset(byte slot)
+{
+  return eepromResumeOffset + 1 + slot*checkpointSize;
+}
+
+byte CheckpointCheck(byte slot)
+{
+  byte buf[checkpointSize-1];
+  for(byte i=0;i<checkpointSize-1;i++) buf[i] = EEPROM.read(checkpointOffset(slot)+i);
+  return ModbusCrc(buf, checkpointSize-1) & 0xFF;
+}
+
+void CheckpointUpdate(int addr, const void *val, byte n)
+{
+  const byte *p = (const byte*)val;
+  for(byte i=0;i<n;i++) if(EEPROM.read(addr+i)!=p[i]) EEPROM.write(addr+i, p[i]);
+}
+
+void CheckpointWrite(byte step, unsigned long elapsed)
+{
+  checkpointSlot = (checkpointSlot+1) % nCheckpoints;
+  checkpointSeq++;
+  int addr = checkpointOffset(checkpointSlot);
+  float sp = setpoint;
+  CheckpointUpdate(addr, &checkpointSeq, 1);
+  CheckpointUpdate(addr+1, &step, 1);
+  CheckpointUpdate(addr+2, &elapsed, 4);
+  CheckpointUpdate(addr+6, &helperVal, 4);
+  CheckpointUpdate(addr+10, &sp, 4);
+  byte check = CheckpointCheck(checkpointSlot);
+  CheckpointUpdate(addr+14, &check, 1);
+  checkpointTime = now;
+}
+
+void ProfileCheckpoint()
+{
+  if(resumePolicy==PROFILE_ABORT || profileHeld) return;
+  CheckpointWrite(curProfStep, ProfileElapsed());
+}
+
+// closes the latest checkpoint, if it's one a profile could be resumed from
+void ProfileCheckpointClear()
+{
+  if(resumePolicy==PROFILE_ABORT) return;
+  int addr = checkpointOffset(checkpointSlot);
+  if(EEPROM.read(addr+1)==checkpointDone || EEPROM.read(addr+14)!=CheckpointCheck(checkpointSlot)) return;
+  CheckpointWrite(checkpointDone, 0);
+}
+
+// how far into the current step the profile is, in ms.  the reverse of ProfileSetElapsed
+unsigned long ProfileElapsed()
+{
+  if(curType==1 || curType==127) //ramp and buzz count down to helperTime
+    return now>=helperTime ? curTime : curTime-(helperTime-now);
+  else if(curType==3 || (curType==2 && !helperflag)) return now-helperTime;
+  return 0; //waiting for a cross
+}
+
+void ProfileSetElapsed(unsigned long elapsed)
+{
+  if(curType==1 || curType==127) helperTime = now + curTime - min(elapsed, curTime);
+  else if(curType==3 || (curType==2 && !helperflag)) helperTime = now - elapsed;
+}
+
+// at power up: find the latest checkpoint and deal with a profile that was cut off
+void ProfileBoot()
+{
+  byte slot = nCheckpoints;
+  for(byte i=0;i<nCheckpoints;i++)
+  {
+    if(EEPROM.read(checkpointOffset(i)+14)!=CheckpointCheck(i)) continue;
+    byte seq = EEPROM.read(checkpointOffset(i));
+    if(slot==nCheckpoints || (signed char)(seq-checkpointSeq)>0)
+    {
+      slot = i;
+      checkpointSeq = seq;
+    }
+  }
+  if(slot==nCheckpoints) return; //never written
+  checkpointSlot = slot;
+
+  int addr = checkpointOffset(slot);
+  byte step = EEPROM.read(addr+1);
+  //under abort a checkpoint left from another policy is ignored, and closed
+  //when the policy is changed again
+  if(step==checkpointDone || resumePolicy==PROFILE_ABORT) return;
+  if(step>=nProfSteps)
+  {
+    ProfileCheckpointClear();
+    return;
+  }
+
+  unsigned long elapsed;
+  float saved, sp;
+  EEPROM_readAnything(addr+2, elapsed);
+  EEPROM_readAnything(addr+6, saved);
+  EEPROM_readAnything(addr+10, sp);
+  now = millis();
+  setpoint = sp;
+  curProfStep = step;
+  runningProfile = true;
+  calcNextProf();
+  if(!runningProfile) return; //the profile has been changed since
+  helperVal = saved; //the ramp's start, or which side of the setpoint a wait started on
+  if(resumePolicy==PROFILE_HOLD)
+  {
+    profileHeld = true;
+    heldElapsed = elapsed;
+  }
+  else ProfileSetElapsed(elapsed);
+  sendResume = true;
+}
+
+void SendResume()
+{
+  Serial.print(F("PRES "));
+  Serial.print(int(resumePolicy));
+  Serial.print(' ');
+  Serial.println(profileHeld ? 2 : (runningProfile ? 1 : 0));
+}
+
+void EEPROMBackupResume()
+{
+  EEPROM.write(eepromResumeOffset, resumePolicy);
+}
+
+void EEPROMRestoreResume()
+{
+  resumePolicy = EEPROM.read(eepromResumeOffset);
+  if(resumePolicy>PROFILE_RESUME) resumePolicy = PROFILE_ABORT;
+}
+
 
 
 
 
-const int eepromTuningOffset = 1; //13 bytes
-const int eepromDashOffset = 14; //9 bytes
-const int eepromATuneOffset = 23; //12 bytes
-const int eepromProfileOffset = 35; //136 bytes
-const int eepromInputOffset = 172; //? bytes (depends on the card)
-const int eepromOutputOffset = 300; //? bytes (depends on the card)
 
 
 void initializeEEPROM()
@@ -918,16 +1577,36 @@ void initializeEEPROM()
     EEPROMBackupInputParams(eepromInputOffset);
     EEPROMBackupOutputParams(eepromOutputOffset);
     EEPROMBackupProfile();
+    EEPROMBackupGain();
+    EEPROMBackupSmith();
+    EEPROMBackupLog();
+    LogClear();
+    EEPROMBackupSafety();
+    EEPROMBackupAdapt();
+    EEPROMBackupAlarm();
+    EEPROMBackupReport();
+    EEPROMBackupSerial();
+    EEPROMBackupResume();
     EEPROM.write(0,EEPROM_ID); //so that first time will never be true again (future firmware updates notwithstanding)
   }
   else
   {
+    ConfigRecover();
     EEPROMRestoreTunings();
     EEPROMRestoreDash();
     EEPROMRestoreATune();
     EEPROMRestoreInputParams(eepromInputOffset);
     EEPROMRestoreOutputParams(eepromOutputOffset);
     EEPROMRestoreProfile();    
+    EEPROMRestoreGain();
+    EEPROMRestoreSmith();
+    EEPROMRestoreLog();
+    EEPROMRestoreSafety();
+    EEPROMRestoreAdapt();
+    EEPROMRestoreAlarm();
+    EEPROMRestoreReport();
+    EEPROMRestoreSerial();
+    EEPROMRestoreResume();
   }
 }  
 
@@ -945,6 +1624,9 @@ void EEPROMBackupTunings()
   EEPROM_writeAnything(eepromTuningOffset+1,kp);
   EEPROM_writeAnything(eepromTuningOffset+5,ki);
   EEPROM_writeAnything(eepromTuningOffset+9,kd);
+  EEPROM_writeAnything(eepromFilterOffset,filterN);
+  EEPROM_writeAnything(eepromFilterOffset+4,weightB);
+  EEPROM_writeAnything(eepromFilterOffset+8,weightC);
 }
 
 void EEPROMRestoreTunings()
@@ -953,6 +1635,9 @@ void EEPROMRestoreTunings()
   EEPROM_readAnything(eepromTuningOffset+1,kp);
   EEPROM_readAnything(eepromTuningOffset+5,ki);
   EEPROM_readAnything(eepromTuningOffset+9,kd);
+  EEPROM_readAnything(eepromFilterOffset,filterN);
+  EEPROM_readAnything(eepromFilterOffset+4,weightB);
+  EEPROM_readAnything(eepromFilterOffset+8,weightC);
 }
 
 void EEPROMBackupDash()
@@ -974,6 +1659,7 @@ void EEPROMBackupATune()
   EEPROM_writeAnything(eepromATuneOffset,aTuneStep);
   EEPROM_writeAnything(eepromATuneOffset+4,aTuneNoise);
   EEPROM_writeAnything(eepromATuneOffset+8,aTuneLookBack);
+  EEPROM.write(eepromATuneOffset+10,aTuneMethod);
 }
 
 void EEPROMRestoreATune()
@@ -981,116 +1667,1130 @@ void EEPROMRestoreATune()
   EEPROM_readAnything(eepromATuneOffset,aTuneStep);
   EEPROM_readAnything(eepromATuneOffset+4,aTuneNoise);
   EEPROM_readAnything(eepromATuneOffset+8,aTuneLookBack);
+  aTuneMethod = EEPROM.read(eepromATuneOffset+10)==1 ? 1 : 0;
 }
 
+// the profile steps (types at +8, values at +24, times at +84) go
+// straight to EEPROM as they're received; only the name lives in RAM.
+// +144 is set while an upload is overwriting the steps and cleared with
+// the name, which comes last, so a half-uploaded profile never runs
 void EEPROMBackupProfile()
 {
   EEPROM_writeAnything(eepromProfileOffset, profname);
-  EEPROM_writeAnything(eepromProfileOffset + 8, proftypes);
-  EEPROM_writeAnything(eepromProfileOffset + 24, profvals);
-  EEPROM_writeAnything(eepromProfileOffset + 85, proftimes); //there might be a slight issue here (/1000?)
+  EEPROM.write(eepromProfileOffset+144, 0);
+}
+
+boolean ProfileComplete()
+{
+  return EEPROM.read(eepromProfileOffset+144)==0;
 }
 
 void EEPROMRestoreProfile()
 {
   EEPROM_readAnything(eepromProfileOffset, profname);
-  EEPROM_readAnything(eepromProfileOffset + 8, proftypes);
-  EEPROM_readAnything(eepromProfileOffset + 24, profvals);
-  EEPROM_readAnything(eepromProfileOffset + 85, proftimes); //there might be a slight issue here (/1000?)
+}
+
+void EEPROMBackupProfileStep(byte step, byte type, float val, unsigned long time)
+{
+  EEPROM.write(eepromProfileOffset + 8 + step, type);
+  EEPROM_writeAnything(eepromProfileOffset + 24 + 4*step, val);
+  EEPROM_writeAnything(eepromProfileOffset + 84 + 4*step, time);
+}
+
+void EEPROMBackupGain()
+{
+  EEPROM.write(eepromGainOffset, gainSource);
+  EEPROM.write(eepromGainOffset+1, gainCount);
+}
+
+void EEPROMRestoreGain()
+{
+  gainSource = EEPROM.read(eepromGainOffset);
+  gainCount = EEPROM.read(eepromGainOffset+1);
+  if(gainCount>nGainSteps || !GainScheduleOk(gainCount)) gainCount = 0;
+}
+
+void EEPROMBackupSmith()
+{
+  EEPROM.write(eepromSmithOffset, smithOn);
+  EEPROM_writeAnything(eepromSmithOffset+1, (float)predictor.GetGain());
+  EEPROM_writeAnything(eepromSmithOffset+5, (float)predictor.GetTimeConstant());
+  EEPROM_writeAnything(eepromSmithOffset+9, (float)predictor.GetDeadTime());
+}
+
+void EEPROMRestoreSmith()
+{
+  float k, t, th;
+  smithOn = EEPROM.read(eepromSmithOffset);
+  EEPROM_readAnything(eepromSmithOffset+1, k);
+  EEPROM_readAnything(eepromSmithOffset+5, t);
+  EEPROM_readAnything(eepromSmithOffset+9, th);
+  predictor.SetModel(k, t, th); //a blank (zero) model is ignored
+}
+
+void EEPROMBackupLog()
+{
+  EEPROM_writeAnything(eepromLogConfigOffset, logInterval);
+}
+
+void EEPROMRestoreLog()
+{
+  EEPROM_readAnything(eepromLogConfigOffset, logInterval);
+  LogRestore();
 }
 
 /********************************************
- * Serial Communication functions / helpers
+ * Online adaptation
+ * proposes PI tunings from the identified model
+ * with the SIMC rules (closed loop time constant
+ * equal to the dead time.)  in apply mode, the
+ * tunings move a quarter of the way towards the
+ * proposal every 30 model samples, but only while
+ * the model is confident and the loop is running
+ * undisturbed in automatic.  applied tunings are
+ * only saved when accepted over serial.
  ********************************************/
+void AdaptRunTime()
+{
+  if(adaptMode==0 || !adapt.Compute()) return;
+  adaptKp = 0;
+  adaptKi = 0;
+  if(!adapt.IsValid()) return;
+  double K = adapt.GetGain(), tau = adapt.GetTimeConstant(), theta = adapt.GetDeadTime();
+  if((K>0) != (ctrlDirection==DIRECT)) return; //model disagrees with the controller
+  double tc = theta>0 ? theta : tau/2;
+  double kc = tau / (abs(K) * (tc + theta));
+  double ti = 4 * (tc + theta);
+  if(tau < ti) ti = tau;
+  adaptKp = constrain(kc, adaptKpMin, adaptKpMax);
+  adaptKi = constrain(kc / ti, adaptKiMin, adaptKiMax);
+
+  if(adaptMode!=2 || ++adaptCount<30) return;
+  adaptCount = 0;
+  if(adapt.GetConfidence()<adaptConfidence || myPID.GetMode()!=AUTOMATIC || tuning || gainSource!=0 || tripCode!=TRIP_NONE) return;
+  kp += (adaptKp - kp) / 4;
+  ki += (adaptKi - ki) / 4;
+  myPID.SetTunings(kp, ki, kd);
+  sendAdapt = true;
+}
 
-boolean ackDash = false, ackTune = false;
-union {                // This Data structure lets
-  byte asBytes[32];    // us take the byte array
-  float asFloat[8];    // sent from processing and
-}                      // easily convert it to a
-foo;                   // float array
+void AdaptConfigure()
+{
+  adapt.SetSampleTime(adaptSample);
+  adapt.SetDeadTime(adaptDeadTime);
+  adaptKp = 0;
+  adaptKi = 0;
+  adaptCount = 0;
+}
 
-// getting float values from processing into the arduino
-// was no small task.  the way this program does it is
-// as follows:
-//  * a float takes up 4 bytes.  in processing, convert
-//    the array of floats we want to send, into an array
-//    of bytes.
-//  * send the bytes to the arduino
-//  * use a data structure known as a union to convert
-//    the array of bytes back into an array of floats
-void SerialReceive()
+void EEPROMBackupAdapt()
 {
+  EEPROM.write(eepromAdaptOffset, adaptMode);
+  EEPROM_writeAnything(eepromAdaptOffset+1, adaptSample);
+  EEPROM_writeAnything(eepromAdaptOffset+5, adaptDeadTime);
+  EEPROM_writeAnything(eepromAdaptOffset+9, adaptKpMin);
+  EEPROM_writeAnything(eepromAdaptOffset+13, adaptKpMax);
+  EEPROM_writeAnything(eepromAdaptOffset+17, adaptKiMin);
+  EEPROM_writeAnything(eepromAdaptOffset+21, adaptKiMax);
+}
 
-  // read the bytes sent from Processing
-  byte index=0;
-  byte identifier=0;
-  byte b1=255,b2=255;
-  boolean boolhelp=false;
+void EEPROMRestoreAdapt()
+{
+  EEPROM_readAnything(eepromAdaptOffset+1, adaptSample);
+  if(!(adaptSample > 0))
+  { //never configured (the area was zeroed by an older firmware's reset)
+    adaptSample = 2;
+    EEPROMBackupAdapt();
+  }
+  adaptMode = EEPROM.read(eepromAdaptOffset);
+  EEPROM_readAnything(eepromAdaptOffset+5, adaptDeadTime);
+  EEPROM_readAnything(eepromAdaptOffset+9, adaptKpMin);
+  EEPROM_readAnything(eepromAdaptOffset+13, adaptKpMax);
+  EEPROM_readAnything(eepromAdaptOffset+17, adaptKiMin);
+  EEPROM_readAnything(eepromAdaptOffset+21, adaptKiMax);
+  AdaptConfigure();
+}
 
-  while(Serial.available())
+void EEPROMBackupSafety()
+{
+  EEPROM_writeAnything(eepromSafetyOffset, maxTemp);
+  EEPROM_writeAnything(eepromSafetyOffset+4, maxRise);
+}
+
+void EEPROMRestoreSafety()
+{
+  EEPROM_readAnything(eepromSafetyOffset, maxTemp);
+  EEPROM_readAnything(eepromSafetyOffset+4, maxRise);
+}
+
+void EEPROMBackupAlarm()
+{
+  EEPROM_writeAnything(eepromAlarmOffset, alarmDevHigh);
+  EEPROM_writeAnything(eepromAlarmOffset+4, alarmDevLow);
+  EEPROM_writeAnything(eepromAlarmOffset+8, alarmRate);
+  EEPROM_writeAnything(eepromAlarmOffset+12, alarmOvershoot);
+  EEPROM_writeAnything(eepromAlarmOffset+16, alarmHorizon);
+  EEPROM_writeAnything(eepromAlarmOffset+20, alarmHyst);
+  EEPROM.write(eepromAlarmOffset+24, alarmLatch);
+}
+
+void EEPROMRestoreAlarm()
+{
+  EEPROM_readAnything(eepromAlarmOffset, alarmDevHigh);
+  EEPROM_readAnything(eepromAlarmOffset+4, alarmDevLow);
+  EEPROM_readAnything(eepromAlarmOffset+8, alarmRate);
+  EEPROM_readAnything(eepromAlarmOffset+12, alarmOvershoot);
+  EEPROM_readAnything(eepromAlarmOffset+16, alarmHorizon);
+  EEPROM_readAnything(eepromAlarmOffset+20, alarmHyst);
+  alarmLatch = EEPROM.read(eepromAlarmOffset+24);
+  if(!(alarmHyst >= 0)) alarmHyst = 0;
+}
+
+/********************************************
+ * Gain scheduling
+ * each breakpoint is 4 floats in EEPROM: the setpoint/input
+ * value it applies at, then kp, ki, kd.  tunings between
+ * breakpoints are interpolated, and the pid takes up the
+ * change in its integral so switching is bumpless.  while
+ * a schedule is in use kp, ki and kd are only the base
+ * tunings, used again once it's turned off: the lcd, TUNE
+ * and Modbus input registers 9-11 show the ones in use
+ ********************************************/
+int gainStepOffset(byte step)
+{
+  return eepromGainOffset + 2 + 16*step;
+}
+
+// a breakpoint the pid can use: all finite, and no negative tunings
+bool GainStepOk(float *vals)
+{
+  for(byte i=0;i<4;i++) if(isnan(vals[i]) || isinf(vals[i])) return false;
+  return vals[1]>=0 && vals[2]>=0 && vals[3]>=0;
+}
+
+// the first count breakpoints are all usable and in ascending order
+bool GainScheduleOk(byte count)
+{
+  float vals[4], last = 0;
+  for(byte i=0;i<count;i++)
   {
-    byte val = Serial.read();
-    if(index==0){ 
-      identifier = val;
-      Serial.println(int(val));
-    }
-    else 
-    {
-      switch(identifier)
-      {
-      case 0: //information request 
-        if(index==1) b1=val; //which info type
-        else if(index==2)boolhelp = (val==1); //on or off
-        break;
-      case 1: //dasboard
-      case 2: //tunings
-      case 3: //autotune
-        if(index==1) b1 = val;
-        else if(index<14)foo.asBytes[index-2] = val; 
-        break;
-      case 4: //EEPROM reset
-        if(index==1) b1 = val; 
-        break;
-      case 5: //input configuration
-        if (index==1)InputSerialReceiveStart();
-        InputSerialReceiveDuring(val, index);
-        break;
-      case 6: //output configuration
-        if (index==1)OutputSerialReceiveStart();
-        OutputSerialReceiveDuring(val, index);
-        break;
-      case 7:  //receiving profile
-        if(index==1) b1=val;
-        else if(b1>=nProfSteps) profname[index-2] = char(val); 
-        else if(index==2) proftypes[b1] = val;
-        else foo.asBytes[index-3] = val;
+    EEPROM_readAnything(gainStepOffset(i), vals);
+    if(!GainStepOk(vals) || (i>0 && !(vals[0]>last))) return false;
+    last = vals[0];
+  }
+  return true;
+}
 
-        break;
-      case 8: //profile command
-        if(index==1) b2=val;
-        break;
-      default:
-        break;
-      }
-    }
-    index++;
+bool GainScheduleOn()
+{
+  return gainSource!=0 && gainCount!=0;
+}
+
+void ApplyGainSchedule()
+{
+  if(!GainScheduleOn()) return;
+  float x = (gainSource==1) ? setpoint : pidInput;
+  float lo[4], hi[4];
+  EEPROM_readAnything(gainStepOffset(0), lo);
+  byte i=1;
+  for(;i<gainCount;i++)
+  {
+    EEPROM_readAnything(gainStepOffset(i), hi);
+    if(x<hi[0]) break;
+    memcpy(lo, hi, sizeof(lo));
   }
+  if(i<gainCount && x>lo[0])
+  { //between two breakpoints
+    float frac = (x-lo[0])/(hi[0]-lo[0]);
+    for(byte j=1;j<4;j++) lo[j] += (hi[j]-lo[j])*frac;
+  }
+  myPID.SetTunings(lo[1], lo[2], lo[3]);
+}
 
-  //we've received the information, time to act
-  switch(identifier)
+void GainStepFromATune()
+{ //autotune results go to the breakpoint closest to where we are running
+  if(!GainScheduleOn()) return;
+  float x = (gainSource==1) ? setpoint : pidInput;
+  byte best=0;
+  float bestDist=0;
+  for(byte i=0;i<gainCount;i++)
   {
-  case 0: //information request
-    switch(b1)
+    float bp;
+    EEPROM_readAnything(gainStepOffset(i), bp);
+    float dist = abs(x-bp);
+    if(i==0 || dist<bestDist)
     {
-    case 0:
-      sendInfo = true; 
-      sendInputConfig=true;
-      sendOutputConfig=true;
-      break;
-    case 1: 
-      sendDash = boolhelp;
-      break;
+      best = i;
+      bestDist = dist;
+    }
+  }
+  float t[3] = {
+    kp, ki, kd  };
+  EEPROM_writeAnything(gainStepOffset(best)+4, t);
+  sendGain = true;
+}
+
+/********************************************
+ * Data logger
+ * input, setpoint and output are recorded every
+ * logInterval seconds into a ring of EEPROM blocks
+ * so history survives the host disconnecting.
+ *
+ * block: [seq][interval][t0][record][record]...
+ *   seq       0-254, one more than the previous
+ *             block. 0xFF marks an empty block
+ *   interval  varint, seconds between records
+ *   t0        varint, seconds since boot at the
+ *             first record
+ * record: [mask][input][setpoint][output]
+ *   mask      bits 0-2 say which of the three values
+ *             follow (the others are unchanged,)
+ *             bit 3 means the input was in error,
+ *             bit 4 that a varint of the seconds
+ *             since boot comes next: the first
+ *             record after a reset, which carries
+ *             on in the block it was writing
+ *   values    zigzag varint of the change in tenths
+ *             since the last record.  each block
+ *             starts from zero, so its first record
+ *             holds absolute values
+ * a 0xFF mask (or the end of the block) ends the
+ * records.  records are logInterval apart, from t0
+ * or the last time mark.  a block is only started
+ * when logging is turned on or the last one fills,
+ * so the history outlasts any number of resets.
+ ********************************************/
+int logAddr(byte block)
+{
+  return eepromLogOffset + block*logBlockSize;
+}
+
+byte logVarint(byte *buf, unsigned long val)
+{
+  byte n=0;
+  while(val>=0x80)
+  {
+    buf[n++] = (val & 0x7F) | 0x80;
+    val >>= 7;
+  }
+  buf[n++] = val;
+  return n;
+}
+
+void LogWrite(byte *buf, byte len)
+{
+  for(byte i=0;i<len;i++) EEPROM.write(logAddr(logBlock)+logPos+i, buf[i]);
+  logPos += len;
+  if(logPos<logBlockSize) EEPROM.write(logAddr(logBlock)+logPos, 0xFF); //end marker
+}
+
+void LogStartBlock(byte block)
+{
+  byte buf[9];
+  byte len=0;
+  logBlock = block;
+  logSeq = (logSeq+1) % 255;
+  logPos = 0;
+  buf[len++] = logSeq;
+  len += logVarint(buf+len, logInterval);
+  len += logVarint(buf+len, millis()/1000);
+  LogWrite(buf, len);
+  logLast[0] = logLast[1] = logLast[2] = 0;
+  logResync = false; //t0 says when
+}
+
+unsigned long LogReadVarint(byte *pos)
+{
+  unsigned long val = 0;
+  byte shift = 0, b;
+  do
+  {
+    b = EEPROM.read(logAddr(logBlock) + (*pos)++);
+    val |= (unsigned long)(b & 0x7F) << shift;
+    shift += 7;
+  } 
+  while((b & 0x80) && *pos<logBlockSize);
+  return val;
+}
+
+// goes through the records in logBlock to find where they end and what the
+// deltas are relative to, so the next record can follow on
+void LogResume()
+{
+  byte pos = 1;
+  unsigned long interval = LogReadVarint(&pos);
+  LogReadVarint(&pos); //t0
+  logLast[0] = logLast[1] = logLast[2] = 0;
+  while(pos<logBlockSize)
+  {
+    byte mask = EEPROM.read(logAddr(logBlock)+pos);
+    if(mask==0xFF) break;
+    pos++;
+    if(mask & 16) LogReadVarint(&pos);
+    for(byte i=0;i<3;i++)
+    {
+      if(!(mask & (1<<i))) continue;
+      unsigned long z = LogReadVarint(&pos);
+      logLast[i] += (long)(z>>1) ^ -(long)(z & 1);
+    }
+  }
+  logPos = pos;
+  //logged at another interval: the next record goes in a new block
+  if(interval!=logInterval || logPos>logBlockSize) logPos = logBlockSize;
+  logResync = true;
+}
+
+void LogClear()
+{
+  for(byte i=0;i<nLogBlocks;i++) EEPROM.write(logAddr(i), 0xFF);
+  logSeq = 254;
+  LogStartBlock(0);
+}
+
+void LogRestore()
+{ //find the newest block and carry on in it
+  for(byte i=0;i<nLogBlocks;i++)
+  {
+    byte seq = EEPROM.read(logAddr(i));
+    if(seq==0xFF) continue;
+    if(EEPROM.read(logAddr((i+1)%nLogBlocks)) != (seq+1)%255)
+    {
+      logSeq = seq;
+      logBlock = i;
+      LogResume();
+      return;
+    }
+  }
+  LogClear(); //nothing usable
+}
+
+void LogRunTime()
+{
+  if(logInterval==0 || (now-logTime) < logInterval*1000UL) return;
+  logTime = now;
+
+  double vals[3] = {
+    input, setpoint, output  };
+  long tenths[3];
+  for(byte i=0;i<3;i++)
+  {
+    double x = constrain(vals[i]*10, -logLimit, logLimit);
+    tenths[i] = isnan(x) ? 0 : (long)(x + (x<0 ? -0.5 : 0.5));
+  }
+  byte buf[1+5+3*5]; //mask, time mark and three values, each at its longest
+  byte len;
+  for(byte attempt=0;attempt<2;attempt++)
+  {
+    byte mask = 0;
+    len = 1;
+    if(logResync)
+    {
+      mask |= 16;
+      len += logVarint(buf+len, now/1000);
+    }
+    for(byte i=0;i<3;i++)
+    {
+      if(isnan(vals[i]))
+      {
+        mask |= 8;
+        continue;
+      }
+      long d = tenths[i] - logLast[i];
+      if(d==0) continue;
+      mask |= 1<<i;
+      len += logVarint(buf+len, (unsigned long)((d<<1) ^ (d>>31)));
+    }
+    buf[0] = mask;
+    if(logPos+len <= logBlockSize) break;
+    LogStartBlock((logBlock+1) % nLogBlocks); //full. deltas restart from zero
+  }
+  LogWrite(buf, len);
+  logResync = false;
+  for(byte i=0;i<3;i++)
+  {
+    if(!isnan(vals[i])) logLast[i] = tenths[i];
+  }
+}
+
+void LogSend()
+{ //the whole ring back to back, oldest block first, as raw binary
+  for(byte n=0;n<nLogBlocks;n++)
+  {
+    byte block = (logBlock + 1 + n) % nLogBlocks;
+    if(EEPROM.read(logAddr(block))==0xFF) continue;
+    Serial.print(F("LOGB "));
+    Serial.print(int(n));
+    Serial.print(' ');
+    for(byte i=0;i<logBlockSize;i++) Serial.write(EEPROM.read(logAddr(block)+i));
+    Serial.println();
+    WatchdogKeepAlive(); //about 75ms a block at 9600 baud
+  }
+  Serial.println(F("LOG_DN"));
+  logDump = false;
+}
+
+/********************************************
+ * Serial Communication functions / helpers
+ ********************************************/
+
+boolean ackDash = false, ackTune = false;
+
+// getting float values from processing into the arduino
+// was no small task.  the way this program does it is
+// as follows:
+//  * a float takes up 4 bytes.  in processing, convert
+//    the array of floats we want to send, into an array
+//    of bytes.
+//  * send the bytes to the arduino
+//  * use a data structure known as a union to convert
+//    the array of bytes back into an array of floats.
+union {                // This Data structure lets
+  byte asBytes[32];    // us take the byte array
+  float asFloat[8];    // sent from processing and
+}                      // easily convert it to a
+serialXfer;            // float array
+
+/********************************************
+ * Configuration snapshot
+ * everything needed to set a unit up (tunings,
+ * dashboard, autotune, input and output card and
+ * the profile) as one binary blob: a version byte,
+ * the length of what follows, the EEPROM areas
+ * below in order, then a CRC-16 (as Modbus, low
+ * byte first.)  it's read with info request 12, as
+ * a hex line, and written with identifier 17, 1
+ * followed by the blob.  nothing is written until
+ * the whole blob has arrived and checked out, then
+ * it all goes to the EEPROM at once (only the bytes
+ * that differ, to save time and wear) and is loaded
+ * the same way it would be at power up.  a marker
+ * byte is set for as long as the write takes; if
+ * it's still set at power up, the write was cut
+ * short and the unit starts on the defaults rather
+ * than a mix of the two configurations.  the header
+ * is looked for on every pass of loop(), and the
+ * blob read as it arrives, since the serial buffer
+ * only holds 64 bytes of it; the host can send it
+ * all in one go.  receiving takes about 250ms at
+ * 9600 baud and writing up to 233 x 3.3ms more, so
+ * loop() stops for up to a second; both keep the
+ * watchdog fed.  the card areas are copied byte for
+ * byte, so a blob only makes sense on a unit with
+ * the same cards.
+ ********************************************/
+const byte configVersion = 2; //1 had 20 bytes of output card
+const byte nConfigAreas = 7;
+const int configArea[nConfigAreas][2] PROGMEM = {
+  { eepromTuningOffset, 13 },
+  { eepromFilterOffset, 12 },
+  { eepromDashOffset, 9 },
+  { eepromATuneOffset, 11 },
+  { eepromProfileOffset, 144 },
+  { eepromInputOffset, 20 },
+  { eepromOutputOffset, 24 }};
+const byte configBody = 233; //the areas added up
+const byte configSize = configBody + 4;
+const unsigned int configTimeout = 100; //ms without a byte before a blob is given up on
+const byte CONFIG_OK = 0, CONFIG_SHORT = 1, CONFIG_VERSION = 2, CONFIG_CRC = 3, CONFIG_BUSY = 4;
+const byte configWriting = 0xA5; //in eepromConfigOffset until the last byte is in
+
+// where byte i of the blob (after the version and length) lives in the EEPROM
+unsigned int ConfigAddress(byte i)
+{
+  for(byte a=0;a<nConfigAreas;a++)
+  {
+    byte len = pgm_read_word(&configArea[a][1]);
+    if(i<len) return pgm_read_word(&configArea[a][0]) + i;
+    i -= len;
+  }
+  return 0;
+}
+
+void ConfigSend()
+{ //built as it's sent, so it never needs the RAM for the whole blob
+  byte head[2] = { configVersion, configBody };
+  unsigned int crc = ModbusCrc(head, 2, 0xFFFF);
+  Serial.print(F("CFG "));
+  if(configVersion<16) Serial.print('0');
+  Serial.print(configVersion, HEX);
+  if(configBody<16) Serial.print('0');
+  Serial.print(configBody, HEX);
+  for(byte i=0;i<configBody;i++)
+  {
+    byte val = EEPROM.read(ConfigAddress(i));
+    crc = ModbusCrc(&val, 1, crc);
+    if(val<16) Serial.print('0');
+    Serial.print(val, HEX);
+  }
+  byte tail[2] = { (byte)(crc & 0xFF), (byte)(crc >> 8) };
+  for(byte i=0;i<2;i++)
+  {
+    if(tail[i]<16) Serial.print('0');
+    Serial.print(tail[i], HEX);
+  }
+  Serial.println();
+}
+
+byte ConfigReceive()
+{ //the blob is too big for the stack.  it borrows the autotune's history instead, which is why it's refused while tuning
+  byte *blob = tuning ? 0 : aTune.Scratch(configSize);
+  byte n = 0;
+  unsigned int idle = 0;
+  while(n<configSize && idle<configTimeout)
+  {
+    if(Serial.available())
+    {
+      byte val = Serial.read();
+      if(blob) blob[n] = val;
+      n++;
+      idle = 0;
+    }
+    else
+    {
+      delay(1);
+      idle++;
+    }
+    WatchdogKeepAlive();
+  }
+  byte result = blob ? ConfigApply(blob, n) : CONFIG_BUSY;
+  if(serialProtocol==PROTOCOL_LEGACY) ConfigAck(result);
+  return result;
+}
+
+// a snapshot cut short by a reset or a power cut leaves a mix of old and new
+// settings that nothing else would notice, so at power up the areas it
+// covers go back to the defaults instead (they're still what's in RAM)
+void ConfigRecover()
+{
+  if(EEPROM.read(eepromConfigOffset)!=configWriting) return;
+  EEPROMBackupTunings();
+  EEPROMBackupDash();
+  EEPROMBackupATune();
+  EEPROMBackupProfile();
+  EEPROMBackupInputParams(eepromInputOffset);
+  EEPROMBackupOutputParams(eepromOutputOffset);
+  EEPROM.write(eepromConfigOffset, 0);
+}
+
+void ConfigAck(byte result)
+{
+  Serial.print(F("CFGACK "));
+  Serial.println(int(result));
+}
+
+byte ConfigApply(byte *blob, byte n)
+{
+  if(n!=configSize) return CONFIG_SHORT;
+  if(blob[0]!=configVersion || blob[1]!=configBody) return CONFIG_VERSION;
+  unsigned int crc = ModbusCrc(blob, configSize-2);
+  if(blob[configSize-2]!=(crc & 0xFF) || blob[configSize-1]!=(crc >> 8)) return CONFIG_CRC;
+  if(tuning || runningProfile || receivingProfile) return CONFIG_BUSY;
+
+  EEPROM.write(eepromConfigOffset, configWriting);
+  for(byte i=0;i<configBody;i++)
+  {
+    unsigned int addr = ConfigAddress(i);
+    if(EEPROM.read(addr)!=blob[2+i]) EEPROM.write(addr, blob[2+i]);
+    WatchdogKeepAlive();
+  }
+  EEPROM.write(eepromConfigOffset, 0);
+
+  EEPROMRestoreTunings();
+  EEPROMRestoreDash();
+  EEPROMRestoreATune();
+  EEPROMRestoreProfile();
+  if(!ProfileComplete()) EEPROM.write(eepromProfileOffset+144, 0); //a blob holds a whole profile
+  EEPROMRestoreInputParams(eepromInputOffset);
+  EEPROMRestoreOutputParams(eepromOutputOffset);
+  myPID.SetOutputLimits(OutputCardMin(), 100);
+  myPID.SetTunings(kp, ki, kd);
+  myPID.SetControllerDirection(ctrlDirection);
+  myPID.SetDerivativeFilter(filterN);
+  myPID.SetSetpointWeights(weightB, weightC);
+  myPID.SetMode(modeIndex);
+  ackDash = true;
+  ackTune = true;
+  sendInputConfig = true;
+  sendOutputConfig = true;
+  return CONFIG_OK;
+}
+
+/********************************************
+ * Addressed bus
+ * the Processing protocol for many controllers
+ * sharing one RS-485 line.  the host sends the
+ * address, then an ordinary message (or nothing,
+ * for a plain poll) and leaves the line quiet for
+ * 3.5 characters.  the unit with that address acts
+ * on it and answers with what SerialSend would
+ * have sent, then "END address".  nothing is ever
+ * sent unasked.  address 0 is a broadcast: only
+ * dashboard messages (setpoint and mode) are taken
+ * from it, by every unit, and none of them answers.
+ * the driver is only enabled while answering, and
+ * released once the last stop bit is out.
+ ********************************************/
+const byte serialMsgSize = 32; //longest message taken (longer ones are cut short, and ignored)
+byte rxFrame[serialMsgSize+1]; //what's come in so far, for either Processing protocol
+byte rxLen = 0;
+unsigned long busByteTime = 0;
+const unsigned long busQuiet = 38500000UL / 9600; //3.5 characters, in microseconds
+const unsigned int txEnableLead = 100; //microseconds for the driver to come up
+
+void SetBusAddress(byte address)
+{
+  if(address<1 || address>247) return;
+  busAddress = address;
+  modbus.SetAddress(address);
+}
+
+void TxEnable(bool on)
+{
+  if(on)
+  {
+    digitalWrite(txEnablePin, HIGH);
+    delayMicroseconds(txEnableLead);
+  }
+  else
+  {
+    Serial.flush(); //waits for the last byte to go out
+    digitalWrite(txEnablePin, LOW);
+  }
+}
+
+void BusPoll()
+{
+  while(Serial.available())
+  {
+    byte val = Serial.read();
+    if(rxLen<sizeof(rxFrame)) rxFrame[rxLen] = val;
+    if(rxLen<255) rxLen++;
+    busByteTime = micros();
+    if(rxLen==3 && rxFrame[0]==busAddress && rxFrame[1]==17 && rxFrame[2]==1)
+    { //a config snapshot doesn't fit the frame; it's read as it comes
+      rxLen = 0;
+      byte result = ConfigReceive();
+      TxEnable(true);
+      ConfigAck(result);
+      SerialSend();
+      Serial.print(F("END "));
+      Serial.println(int(busAddress));
+      TxEnable(false);
+      return;
+    }
+  }
+  if(rxLen==0 || micros() - busByteTime < busQuiet) return;
+  byte len = rxLen - 1;
+  rxLen = 0;
+  if(rxFrame[0]==busAddress)
+  {
+    TxEnable(true);
+    SerialHandle(rxFrame+1, len, false);
+    SerialSend();
+    Serial.print(F("END "));
+    Serial.println(int(busAddress));
+    TxEnable(false);
+  }
+  else if(rxFrame[0]==0 && len>0 && rxFrame[1]==1) SerialHandle(rxFrame+1, len, true);
+}
+
+/********************************************
+ * Modbus RTU
+ * the alternative to the Processing protocol, for
+ * SCADA.  nothing is sent unless asked for.  all
+ * registers are signed: temperatures and the output
+ * in tenths, kp and kd in hundredths, ki in
+ * thousandths.  a failed input reads 0x8000.
+ * input registers (read only):
+ *   0 input  1 setpoint  2 output  3 mode
+ *   4 status: 1 tuning, 2 profile running,
+ *     4 input failed, 8 tripped, 16 profile held
+ *   5 trip code  6 alarms  7 profile step
+ *   8 profile step type
+ *   9 kp  10 ki  11 kd: the tunings in use, which a
+ *     gain schedule moves away from 4-6 below
+ * holding registers:
+ *   0 setpoint  1 output (manual only, refused
+ *     with illegal value in automatic)
+ *   2 mode  3 direction  4 kp  5 ki  6 kd (the
+ *     base tunings, see the gain schedule)
+ *   7 autotune (1 starts, 0 cancels)
+ *   8 autotune step  9 noise band  10 lookback (sec)
+ *   11 autotune method  12 profile (1 runs or
+ *      lets a held one carry on, 0 stops)
+ *   13 protocol (0 Processing, 2 Processing on
+ *      the addressed bus)
+ *   14 slave address (shared with the bus)
+ * changed settings go to the EEPROM once per
+ * request, however many registers it wrote.
+ ********************************************/
+const byte MB_SAVE_DASH = 1, MB_SAVE_TUNE = 2, MB_SAVE_ATUNE = 4, MB_SAVE_SERIAL = 8;
+
+unsigned int ModbusScale(double val, double scale)
+{
+  if(isnan(val)) return 0x8000;
+  val *= scale;
+  if(val > 32767) val = 32767;
+  else if(val < -32767) val = -32767;
+  return (unsigned int)(int)(val<0 ? val-0.5 : val+0.5);
+}
+
+byte ModbusRead(byte table, unsigned int reg, unsigned int* val)
+{
+  if(table==MB_READ_INPUT)
+  {
+    switch(reg)
+    {
+    case 0: *val = ModbusScale(inputOk ? input : NAN, 10); break;
+    case 1: *val = ModbusScale(setpoint, 10); break;
+    case 2: *val = ModbusScale(output, 10); break;
+    case 3: *val = myPID.GetMode(); break;
+    case 4: *val = (tuning?1:0) | (runningProfile?2:0) | (inputOk?0:4) | (tripCode!=TRIP_NONE?8:0) | (profileHeld?16:0); break;
+    case 5: *val = tripCode; break;
+    case 6: *val = AlarmState(); break;
+    case 7: *val = curProfStep; break;
+    case 8: *val = curType; break;
+    case 9: *val = ModbusScale(myPID.GetKp(), 100); break;
+    case 10: *val = ModbusScale(myPID.GetKi(), 1000); break;
+    case 11: *val = ModbusScale(myPID.GetKd(), 100); break;
+    default: return MB_ILLEGAL_ADDRESS;
+    }
+    return 0;
+  }
+  switch(reg)
+  {
+  case 0: *val = ModbusScale(setpoint, 10); break;
+  case 1: *val = ModbusScale(output, 10); break;
+  case 2: *val = myPID.GetMode(); break;
+  case 3: *val = ctrlDirection; break;
+  case 4: *val = ModbusScale(kp, 100); break;
+  case 5: *val = ModbusScale(ki, 1000); break;
+  case 6: *val = ModbusScale(kd, 100); break;
+  case 7: *val = tuning; break;
+  case 8: *val = ModbusScale(aTuneStep, 10); break;
+  case 9: *val = ModbusScale(aTuneNoise, 10); break;
+  case 10: *val = aTuneLookBack; break;
+  case 11: *val = aTuneMethod; break;
+  case 12: *val = runningProfile; break;
+  case 13: *val = serialProtocol; break;
+  case 14: *val = busAddress; break;
+  default: return MB_ILLEGAL_ADDRESS;
+  }
+  return 0;
+}
+
+byte ModbusWrite(unsigned int reg, unsigned int val)
+{
+  double v = (int16_t)val;
+  if(reg>=4 && reg<=6 && v<0) return MB_ILLEGAL_VALUE;
+  switch(reg)
+  {
+  case 0: 
+    setpoint = v/10;
+    modbusSave |= MB_SAVE_DASH;
+    break;
+  case 1: 
+    if(myPID.GetMode()!=MANUAL) return MB_ILLEGAL_VALUE; //the pid owns it
+    output = constrain(v/10, OutputCardMin(), 100);
+    modbusSave |= MB_SAVE_DASH;
+    break;
+  case 2: 
+    if(val>1) return MB_ILLEGAL_VALUE;
+    modeIndex = val;
+    myPID.SetMode(modeIndex);
+    modbusSave |= MB_SAVE_DASH;
+    break;
+  case 3: 
+    if(val>1) return MB_ILLEGAL_VALUE;
+    ctrlDirection = val;
+    myPID.SetControllerDirection(ctrlDirection);
+    modbusSave |= MB_SAVE_TUNE;
+    break;
+  case 4: 
+  case 5: 
+  case 6: 
+    if(reg==4) kp = v/100;
+    else if(reg==5) ki = v/1000;
+    else kd = v/100;
+    myPID.SetTunings(kp, ki, kd);
+    modbusSave |= MB_SAVE_TUNE;
+    break;
+  case 7: 
+    if(val>1) return MB_ILLEGAL_VALUE;
+    if((val==1)!=tuning) changeAutoTune();
+    break;
+  case 8: 
+    aTuneStep = v/10;
+    modbusSave |= MB_SAVE_ATUNE;
+    break;
+  case 9: 
+    aTuneNoise = v/10;
+    modbusSave |= MB_SAVE_ATUNE;
+    break;
+  case 10: 
+    aTuneLookBack = val;
+    modbusSave |= MB_SAVE_ATUNE;
+    break;
+  case 11: 
+    if(val>1 || tuning) return MB_ILLEGAL_VALUE;
+    aTuneMethod = val;
+    modbusSave |= MB_SAVE_ATUNE;
+    break;
+  case 12: 
+    if(val>1) return MB_ILLEGAL_VALUE;
+    if(val==1) StartProfile();
+    else StopProfile();
+    break;
+  case 13: 
+    if(val>2) return MB_ILLEGAL_VALUE;
+    serialProtocol = val;
+    if(serialProtocol==PROTOCOL_LEGACY) sendInfo = true;
+    rxLen = 0;
+    modbusSave |= MB_SAVE_SERIAL;
+    break;
+  case 14: 
+    if(val<1 || val>247) return MB_ILLEGAL_VALUE;
+    SetBusAddress(val); //this answer still goes out from the old address
+    modbusSave |= MB_SAVE_SERIAL;
+    break;
+  default: 
+    return MB_ILLEGAL_ADDRESS;
+  }
+  return 0;
+}
+
+void ModbusCommit()
+{
+  if(modbusSave & MB_SAVE_DASH) EEPROMBackupDash();
+  if(modbusSave & MB_SAVE_TUNE) EEPROMBackupTunings();
+  if(modbusSave & MB_SAVE_ATUNE) EEPROMBackupATune();
+  if(modbusSave & MB_SAVE_SERIAL) EEPROMBackupSerial();
+  modbusSave = 0;
+}
+
+void EEPROMBackupSerial()
+{
+  EEPROM.write(eepromSerialOffset, serialProtocol);
+  EEPROM.write(eepromSerialOffset+1, busAddress);
+}
+
+void EEPROMRestoreSerial()
+{
+  serialProtocol = EEPROM.read(eepromSerialOffset);
+  if(serialProtocol>PROTOCOL_BUS) serialProtocol = PROTOCOL_LEGACY;
+  SetBusAddress(EEPROM.read(eepromSerialOffset+1)); //0 from an older firmware's reset keeps address 1
+}
+
+
+/********************************************
+ * Report by exception
+ * instead of DASH and TUNE every 500ms, each line
+ * is only sent when something in it has moved: the
+ * setpoint, input or output by more than its
+ * deadband, or anything else at all.  mode changes,
+ * profile steps, trips, alarms and a failed input
+ * are reported on the next io cycle.  the heartbeat
+ * resends both lines when nothing has changed for
+ * that long, so the other end can tell we're alive.
+ * what's saved is the lines nobody needed, not the
+ * bytes within a line: when one field moves the
+ * whole line goes, in the same format as ever, so
+ * the Processing front end parses it unchanged and
+ * there's no partial state for it to get wrong.
+ * sending only the moved fields, tagged, would save
+ * up to 2/3 of a DASH line more, at the price of a
+ * new line format on both ends.
+ ********************************************/
+byte reportMode = 0; //0 = every 500ms, 1 = by exception
+float reportBand[3] = { 
+  0.5, 0.1, 1}; //setpoint, input, output deadbands
+uint16_t reportBeat = 10; //sec, 0 = no heartbeat
+float reportLast[3], reportTune[3];
+byte reportState = 0xFF, reportStep = 0xFF, reportTuneState = 0xFF;
+unsigned long dashReportTime = 0, tuneReportTime = 0;
+
+bool ReportMoved(byte i, float val)
+{
+  return !(abs(val - reportLast[i]) <= reportBand[i]);
+}
+
+bool ReportBeat(unsigned long last)
+{
+  return reportBeat!=0 && now - last >= reportBeat * 1000UL;
+}
+
+void ReportRunTime()
+{
+  if(reportMode==0 || serialProtocol!=PROTOCOL_LEGACY) return;
+  byte state = myPID.GetMode() | (tuning?2:0) | (inputOk?4:0) | (tripCode!=TRIP_NONE?8:0) | (AlarmState()?16:0);
+  byte step = runningProfile ? curProfStep : 0xFF;
+  if(sendDash && (ackDash || state!=reportState || step!=reportStep || ReportBeat(dashReportTime) ||
+    ReportMoved(0, setpoint) || (inputOk && ReportMoved(1, input)) || ReportMoved(2, output)))
+  {
+    SendDash();
+    if(runningProfile) SendProfile();
+    reportLast[0] = setpoint;
+    reportLast[1] = input;
+    reportLast[2] = output;
+    reportState = state;
+    reportStep = step;
+    dashReportTime = now;
+  }
+
+  byte tuneState = myPID.GetDirection() | (tuning?2:0);
+  if(sendTune && (ackTune || tuneState!=reportTuneState || ReportBeat(tuneReportTime) ||
+    myPID.GetKp()!=reportTune[0] || myPID.GetKi()!=reportTune[1] || myPID.GetKd()!=reportTune[2]))
+  {
+    SendTune();
+    reportTune[0] = myPID.GetKp();
+    reportTune[1] = myPID.GetKi();
+    reportTune[2] = myPID.GetKd();
+    reportTuneState = tuneState;
+    tuneReportTime = now;
+  }
+}
+
+void ReportConfigure()
+{ //so the first report goes out straight away
+  reportState = 0xFF;
+  reportTuneState = 0xFF;
+}
+
+void EEPROMBackupReport()
+{
+  EEPROM.write(eepromReportOffset, reportMode);
+  EEPROM_writeAnything(eepromReportOffset+1, reportBand);
+  EEPROM_writeAnything(eepromReportOffset+13, reportBeat);
+}
+
+void EEPROMRestoreReport()
+{
+  reportMode = EEPROM.read(eepromReportOffset);
+  EEPROM_readAnything(eepromReportOffset+1, reportBand);
+  EEPROM_readAnything(eepromReportOffset+13, reportBeat);
+  ReportConfigure();
+}
+
+// takes in the bytes sent from Processing on every pass of loop(), though
+// they're only acted on every 500ms.  that way a config snapshot is caught
+// by its header: the chip only holds the first 64 bytes of one
+void SerialPoll()
+{
+  while(Serial.available())
+  {
+    byte val = Serial.read();
+    if(rxLen<serialMsgSize) rxFrame[rxLen] = val;
+    if(rxLen<255) rxLen++;
+    if(rxLen==2 && rxFrame[0]==17 && rxFrame[1]==1)
+    {
+      rxLen = 0;
+      Serial.println(17);
+      ConfigReceive();
+      return;
+    }
+  }
+}
+
+void SerialReceive()
+{
+  SerialPoll();
+  byte len = rxLen;
+  rxLen = 0;
+  SerialHandle(rxFrame, len, false);
+}
+
+// acts on one message.  quiet leaves out the echo, for broadcasts
+void SerialHandle(byte *msg, byte len, bool quiet)
+{
+  byte index=0;
+  byte identifier=0;
+  byte b1=255,b2=255;
+  boolean boolhelp=false;
+
+  while(index<len)
+  {
+    byte val = index<serialMsgSize ? msg[index] : 0;
+    if(index==0){ 
+      identifier = val;
+      if(!quiet) Serial.println(int(val));
+    }
+    else 
+    {
+      switch(identifier)
+      {
+      case 0: //information request 
+        if(index==1) b1=val; //which info type
+        else if(index==2)boolhelp = (val==1); //on or off
+        break;
+      case 1: //dasboard
+      case 10: //smith predictor
+      case 11: //data logger
+      case 12: //safety limits
+        if(index==1) b1 = val;
+        else if(index<14)serialXfer.asBytes[index-2] = val; 
+        break;
+      case 14: //alarms
+        if(index==1) b1 = val;
+        else if(index<30)serialXfer.asBytes[index-2] = val; 
+        break;
+      case 3: //autotune (optionally followed by the method)
+      case 13: //online adaptation
+      case 2: //tunings (optionally followed by filter N and setpoint weights b, c)
+        if(index==1) b1 = val;
+        else if(index<26)serialXfer.asBytes[index-2] = val; 
+        break;
+      case 4: //EEPROM reset
+        if(index==1) b1 = val; 
+        break;
+      case 5: //input configuration
+        if (index==1)InputSerialReceiveStart();
+        InputSerialReceiveDuring(val, index);
+        break;
+      case 6: //output configuration
+        if (index==1)OutputSerialReceiveStart();
+        OutputSerialReceiveDuring(val, index);
+        break;
+      case 7:  //receiving profile
+        if(index==1) b1=val;
+        else if(b1>=nProfSteps) profname[index-2] = char(val); 
+        else if(index==2) b2 = val; //step type
+        else serialXfer.asBytes[index-3] = val;
+
+        break;
+      case 8: //profile command (2 sets the resume policy, which follows)
+        if(index==1) b2=val;
+        else if(index==2) b1=val;
+        break;
+      case 16: //serial protocol
+        if(index==1) b1 = val;
+        else if(index==2) b2 = val;
+        break;
+      case 9: //gain schedule
+      case 15: //report by exception
+        if(index==1) b1 = val;
+        else if(index<18)serialXfer.asBytes[index-2] = val; 
+        break;
+      default:
+        break;
+      }
+    }
+    index++;
+  }
+
+  //we've received the information, time to act
+  switch(identifier)
+  {
+  case 0: //information request
+    switch(b1)
+    {
+    case 0:
+      sendInfo = true; 
+      sendInputConfig=true;
+      sendOutputConfig=true;
+      break;
+    case 1: 
+      sendDash = boolhelp;
+      break;
     case 2: 
       sendTune = boolhelp;
       break;
@@ -1100,6 +2800,33 @@ void SerialReceive()
     case 4: 
       sendOutputConfig = boolhelp;
       break;
+    case 5: 
+      sendGain = boolhelp;
+      break;
+    case 6: 
+      sendSmith = boolhelp;
+      break;
+    case 7: 
+      sendMem = true; //one shot
+      break;
+    case 8: 
+      sendSafety = true; //one shot
+      break;
+    case 9: 
+      sendAdapt = true; //one shot
+      break;
+    case 10: 
+      sendAlarm = true; //one shot
+      break;
+    case 11: 
+      sendReport = true; //one shot
+      break;
+    case 12: 
+      sendConfig = true; //one shot
+      break;
+    case 13: 
+      sendResume = true; //one shot
+      break;
     default: 
       break;
     }
@@ -1107,13 +2834,13 @@ void SerialReceive()
   case 1: //dashboard
     if(index==14  && b1<2)
     {
-      setpoint=double(foo.asFloat[0]);
-      //Input=double(foo.asFloat[1]);       // * the user has the ability to send the 
+      setpoint=double(serialXfer.asFloat[0]);
+      //Input=double(serialXfer.asFloat[1]);       // * the user has the ability to send the 
       //   value of "Input"  in most cases (as 
       //   in this one) this is not needed.
       if(b1==0)                       // * only change the output if we are in 
       {                                     //   manual mode.  otherwise we'll get an
-        output=double(foo.asFloat[2]);      //   output blip, then the controller will 
+        output=double(serialXfer.asFloat[2]);      //   output blip, then the controller will 
       }                                     //   overwrite.
 
       if(b1==0) myPID.SetMode(MANUAL);// * set the controller mode
@@ -1123,14 +2850,25 @@ void SerialReceive()
     }
     break;
   case 2: //Tune
-    if(index==14 && (b1<=1))
+    if((index==14 || index==26) && (b1<=1))
     {
       // * read in and set the controller tunings
-      kp = double(foo.asFloat[0]);           //
-      ki = double(foo.asFloat[1]);           //
-      kd = double(foo.asFloat[2]);           //
+      kp = double(serialXfer.asFloat[0]);           //
+      ki = double(serialXfer.asFloat[1]);           //
+      kd = double(serialXfer.asFloat[2]);           //
       ctrlDirection = b1;
       myPID.SetTunings(kp, ki, kd);            //    
+      if(index==26)
+      { // * the longer packet also carries the derivative
+        filterN = double(serialXfer.asFloat[3]);     //   filter and the setpoint weights
+        weightB = double(serialXfer.asFloat[4]);     //
+        weightC = double(serialXfer.asFloat[5]);     //
+        myPID.SetDerivativeFilter(filterN);
+        myPID.SetSetpointWeights(weightB, weightC);
+        filterN = myPID.GetDerivativeFilter(); //in case the pid rejected them
+        weightB = myPID.GetSetpointWeightP();
+        weightC = myPID.GetSetpointWeightD();
+      }
       if(b1==0) myPID.SetControllerDirection(DIRECT);// * set the controller Direction
       else myPID.SetControllerDirection(REVERSE);          //
       EEPROMBackupTunings();
@@ -1138,12 +2876,13 @@ void SerialReceive()
     }
     break;
   case 3: //ATune
-    if(index==14 && (b1<=1))
+    if((index==14 || index==18) && (b1<=1))
     {
 
-      aTuneStep = foo.asFloat[0];
-      aTuneNoise = foo.asFloat[1];    
-      aTuneLookBack = (unsigned int)foo.asFloat[2];
+      aTuneStep = serialXfer.asFloat[0];
+      aTuneNoise = serialXfer.asFloat[1];    
+      aTuneLookBack = (uint16_t)serialXfer.asFloat[2];
+      if(index==18 && !tuning) aTuneMethod = serialXfer.asFloat[3]==1 ? 1 : 0;
       if((!tuning && b1==1)||(tuning && b1==0))
       { //toggle autotune state
         changeAutoTune();
@@ -1161,6 +2900,7 @@ void SerialReceive()
     break;
   case 6: //ouput configuration
     OutputSerialReceiveAfter(eepromOutputOffset);
+    myPID.SetOutputLimits(OutputCardMin(), 100); //split range or not
     sendOutputConfig=true;
     break;
   case 7: //receiving profile
@@ -1168,9 +2908,10 @@ void SerialReceive()
     if((index==11 || (b1>=nProfSteps && index==9) ))
     {
       if(!receivingProfile && b1!=0)
-      { //there was a timeout issue.  reset this transfer
+      { //there was a timeout issue.  reset this transfer.  the steps that
+        //made it are in, so the profile stays unusable until a full upload
         receivingProfile=false;
-        Serial.println("ProfError");
+        Serial.println(F("ProfError"));
         EEPROMRestoreProfile();
       }
       else if(receivingProfile || b1==0)
@@ -1184,28 +2925,29 @@ void SerialReceive()
         {
           receivingProfile = true;
           profReceiveStart = millis();
+          EEPROM.write(eepromProfileOffset+144, 1); //until the name arrives
         }
 
         if(b1>=nProfSteps)
         { //getting the name is the last step
           receivingProfile=false; //last profile step
-          Serial.print("ProfDone ");
+          Serial.print(F("ProfDone "));
           Serial.println(profname);
           EEPROMBackupProfile();
-          Serial.println("Archived");
+          Serial.println(F("Archived"));
         }
         else
         {
-          profvals[b1] = foo.asFloat[0];
-          proftimes[b1] = (unsigned long)(foo.asFloat[1] * 1000);
-          Serial.print("ProfAck ");
+          unsigned long time = (unsigned long)(serialXfer.asFloat[1] * 1000);
+          EEPROMBackupProfileStep(b1, b2, serialXfer.asFloat[0], time);
+          Serial.print(F("ProfAck "));
           Serial.print(b1);           
-          Serial.print(" ");
-          Serial.print(proftypes[b1]);           
-          Serial.print(" ");
-          Serial.print(profvals[b1]);           
-          Serial.print(" ");
-          Serial.println(proftimes[b1]);           
+          Serial.print(' ');
+          Serial.print(b2);           
+          Serial.print(' ');
+          Serial.print(serialXfer.asFloat[0]);           
+          Serial.print(' ');
+          Serial.println(time);           
         }
       }
     }
@@ -1217,6 +2959,145 @@ void SerialReceive()
       else StopProfile();
 
     }
+    else if(index==3 && b2==2 && b1<=PROFILE_RESUME)
+    {
+      resumePolicy = b1;
+      EEPROMBackupResume();
+      //neither writes under abort.  otherwise, one a past profile left behind is closed
+      if(runningProfile) ProfileCheckpoint();
+      else ProfileCheckpointClear();
+      sendResume = true;
+    }
+    break;
+  case 9: //gain schedule
+    if(b1<nGainSteps && index==18 && GainStepOk(serialXfer.asFloat))
+    { //a breakpoint: value, kp, ki, kd
+      float old[4];
+      EEPROM_readAnything(gainStepOffset(b1), old);
+      for(byte i=0;i<4;i++) EEPROM_writeAnything(gainStepOffset(b1)+4*i, serialXfer.asFloat[i]);
+      if(b1<gainCount && !GainScheduleOk(gainCount)) EEPROM_writeAnything(gainStepOffset(b1), old); //would put the schedule in use out of order
+      sendGain = true;
+    }
+    else if(b1>=nGainSteps && index==4 && serialXfer.asBytes[0]<=2 && serialXfer.asBytes[1]<=nGainSteps
+            && GainScheduleOk(serialXfer.asBytes[1]))
+    { //which variable to key on, and how many breakpoints are in use
+      gainSource = serialXfer.asBytes[0];
+      gainCount = serialXfer.asBytes[1];
+      EEPROMBackupGain();
+      if(!GainScheduleOn()) myPID.SetTunings(kp, ki, kd); //back to the fixed tunings
+      sendGain = true;
+    }
+    break;
+  case 11: //data logger
+    if(b1==0 && index==6)
+    { //set the interval (seconds, 0 turns logging off)
+      logInterval = (uint16_t)serialXfer.asFloat[0];
+      EEPROMBackupLog();
+      if(logInterval>0) LogStartBlock((logBlock+1) % nLogBlocks);
+      Serial.print(F("LogAck "));
+      Serial.println(logInterval);
+    }
+    else if(b1==1 && index==2) logDump = true; //download
+    else if(b1==2 && index==2) LogClear();
+    break;
+  case 13: //online adaptation
+    if(b1<=2 && index==26)
+    { //mode, then sample time, dead time, kp min/max, ki min/max
+      adaptMode = b1;
+      adaptSample = serialXfer.asFloat[0];
+      adaptDeadTime = serialXfer.asFloat[1];
+      adaptKpMin = serialXfer.asFloat[2];
+      adaptKpMax = serialXfer.asFloat[3];
+      adaptKiMin = serialXfer.asFloat[4];
+      adaptKiMax = serialXfer.asFloat[5];
+      if(!(adaptSample>0)) adaptSample = 2;
+      EEPROMBackupAdapt();
+      AdaptConfigure();
+      sendAdapt = true;
+    }
+    else if(b1==3 && index==2 && adaptKp>0)
+    { //accept the proposal and keep it
+      kp = adaptKp;
+      ki = adaptKi;
+      myPID.SetTunings(kp, ki, kd);
+      EEPROMBackupTunings();
+      sendAdapt = true;
+    }
+    else if(b1==4 && index==2)
+    { //start identifying from scratch
+      AdaptConfigure();
+      sendAdapt = true;
+    }
+    break;
+  case 12: //safety
+    if(b1==0 && index==10)
+    { //limits: max temperature, max rise (deg/min)
+      maxTemp = serialXfer.asFloat[0];
+      maxRise = serialXfer.asFloat[1];
+      EEPROMBackupSafety();
+      sendSafety = true;
+    }
+    else if(b1==1 && index==2)
+    { //clear a trip
+      tripCode = TRIP_NONE;
+      riseTime = 0;
+      sendSafety = true;
+    }
+    break;
+  case 14: //alarms
+    if(b1==0 && index==30)
+    { //deviation high, low, rate (deg/min), overshoot, horizon (sec), hysteresis, latch mask
+      alarmDevHigh = serialXfer.asFloat[0];
+      alarmDevLow = serialXfer.asFloat[1];
+      alarmRate = serialXfer.asFloat[2];
+      alarmOvershoot = serialXfer.asFloat[3];
+      alarmHorizon = serialXfer.asFloat[4];
+      alarmHyst = serialXfer.asFloat[5];
+      alarmLatch = (byte)serialXfer.asFloat[6];
+      if(!(alarmHyst >= 0)) alarmHyst = 0;
+      EEPROMBackupAlarm();
+      sendAlarm = true;
+    }
+    else if(b1==1 && index==2)
+    { //acknowledge
+      AlarmAcknowledge();
+      sendAlarm = true;
+    }
+    break;
+  case 15: //report by exception: mode, then the setpoint, input and output deadbands and the heartbeat (sec)
+    if(b1<2 && index==18)
+    {
+      reportMode = b1;
+      for(byte i=0;i<3;i++) reportBand[i] = abs(serialXfer.asFloat[i]);
+      reportBeat = (uint16_t)serialXfer.asFloat[3];
+      EEPROMBackupReport();
+      ReportConfigure();
+      sendReport = true;
+    }
+    break;
+  case 16: //serial protocol, then the bus/modbus address
+    if(index==3 && b1<3 && b2>=1 && b2<=247)
+    {
+      Serial.print(F("PROTO "));
+      Serial.print(int(b1));
+      Serial.print(' ');
+      Serial.println(int(b2));
+      serialProtocol = b1;
+      SetBusAddress(b2);
+      modbus.Flush();
+      rxLen = 0;
+      EEPROMBackupSerial();
+    }
+    break;
+  case 10: //smith predictor: on/off, then process gain, time constant, dead time
+    if(index==14 && b1<2)
+    {
+      predictor.SetModel(serialXfer.asFloat[0], serialXfer.asFloat[1], serialXfer.asFloat[2]);
+      if(b1==1 && !smithOn) predictor.Reset(); //start from zero correction
+      smithOn = b1;
+      EEPROMBackupSmith();
+      sendSmith = true;
+    }
     break;
   default: 
     break;
@@ -1232,96 +3113,233 @@ void SerialSend()
 {
   if(sendInfo)
   {//just send out the stock identifier
-    Serial.print("\nosPID v1.70");
+    Serial.print(F("\nosPID v1.70"));
     InputSerialID();
     OutputSerialID();
-    Serial.println("");
+    Serial.println();
     sendInfo = false; //only need to send this info once per request
   }
-  if(sendDash)
-  {
-    Serial.print("DASH ");
-    Serial.print(setpoint); 
-    Serial.print(" ");
-    if(isnan(input)) Serial.print("Error");
-    else Serial.print(input); 
-    Serial.print(" ");
-    Serial.print(output); 
-    Serial.print(" ");
-    Serial.print(myPID.GetMode());
-    Serial.print(" ");
-    Serial.println(ackDash?1:0);
-    if(ackDash)ackDash=false;
-  }
-  if(sendTune)
-  {
-    Serial.print("TUNE ");
-    Serial.print(myPID.GetKp()); 
-    Serial.print(" ");
-    Serial.print(myPID.GetKi()); 
-    Serial.print(" ");
-    Serial.print(myPID.GetKd()); 
-    Serial.print(" ");
-    Serial.print(myPID.GetDirection()); 
-    Serial.print(" ");
-    Serial.print(tuning?1:0);
-    Serial.print(" ");
-    Serial.print(aTuneStep); 
-    Serial.print(" ");
-    Serial.print(aTuneNoise); 
-    Serial.print(" ");
-    Serial.print(aTuneLookBack); 
-    Serial.print(" ");
-    Serial.println(ackTune?1:0);
-    if(ackTune)ackTune=false;
+  if(reportMode==0 || serialProtocol==PROTOCOL_BUS)
+  { //by exception, ReportRunTime sends these instead
+    if(sendDash) SendDash();
+    if(sendTune) SendTune();
   }
   if(sendInputConfig)
   {
-    Serial.print("IPT ");
+    Serial.print(F("IPT "));
     InputSerialSend();
     sendInputConfig=false;
   }
   if(sendOutputConfig)
   {
-    Serial.print("OPT ");
+    Serial.print(F("OPT "));
     OutputSerialSend();
     sendOutputConfig=false;
   }
-  if(runningProfile)
+  if(sendGain)
   {
-    Serial.print("PROF ");
-    Serial.print(int(curProfStep));
-    Serial.print(" ");
-    Serial.print(int(curType));
-    Serial.print(" ");
-switch(curType)
+    Serial.print(F("GAIN "));
+    Serial.print(int(gainSource));
+    Serial.print(' ');
+    Serial.print(int(gainCount));
+    for(byte i=0;i<nGainSteps;i++)
+    {
+      float vals[4];
+      EEPROM_readAnything(gainStepOffset(i), vals);
+      for(byte j=0;j<4;j++)
+      {
+        Serial.print(' ');
+        PrintNumber(Serial, vals[j]);
+      }
+    }
+    Serial.println();
+    sendGain=false;
+  }
+  if(sendSmith)
+  {
+    Serial.print(F("SMITH "));
+    Serial.print(int(smithOn));
+    Serial.print(' ');
+    PrintNumber(Serial, predictor.GetGain());
+    Serial.print(' ');
+    PrintNumber(Serial, predictor.GetTimeConstant());
+    Serial.print(' ');
+    PrintNumber(Serial, predictor.GetDeadTime());
+    Serial.println();
+    sendSmith=false;
+  }
+  if(sendMem)
+  { //stack never used, free RAM now, lowest free RAM seen, reset cause (MCUSR)
+    Serial.print(F("MEM "));
+    Serial.print(stackUnused);
+    Serial.print(' ');
+    Serial.print(FreeRam());
+    Serial.print(' ');
+    Serial.print(minFreeRam);
+    Serial.print(' ');
+    Serial.println(int(resetCause));
+    sendMem=false;
+  }
+  if(sendSafety)
+  { //trip now, last recorded trip and its value, limits
+    float lastVal;
+    EEPROM_readAnything(eepromTripOffset+1, lastVal);
+    Serial.print(F("SAFE "));
+    Serial.print(int(tripCode));
+    Serial.print(' ');
+    Serial.print(int(EEPROM.read(eepromTripOffset)));
+    Serial.print(' ');
+    PrintNumber(Serial, lastVal);
+    Serial.print(' ');
+    PrintNumber(Serial, maxTemp);
+    Serial.print(' ');
+    PrintNumber(Serial, maxRise);
+    Serial.println();
+    sendSafety=false;
+  }
+  if(sendAdapt)
+  { //mode, confidence, model (gain, time constant, dead time), proposal, tunings in use
+    Serial.print(F("ADAPT "));
+    Serial.print(int(adaptMode));
+    Serial.print(' ');
+    PrintNumber(Serial, adapt.GetConfidence(), 3);
+    Serial.print(' ');
+    PrintNumber(Serial, adapt.GetGain(), 4);
+    Serial.print(' ');
+    PrintNumber(Serial, adapt.GetTimeConstant());
+    Serial.print(' ');
+    PrintNumber(Serial, adapt.GetDeadTime());
+    Serial.print(' ');
+    PrintNumber(Serial, adaptKp, 3);
+    Serial.print(' ');
+    PrintNumber(Serial, adaptKi, 4);
+    Serial.print(' ');
+    PrintNumber(Serial, kp, 3);
+    Serial.print(' ');
+    PrintNumber(Serial, ki, 4);
+    Serial.println();
+    sendAdapt=false;
+  }
+  if(sendAlarm)
+  { //alarms up, latched, silenced, then the limits
+    Serial.print(F("ALMCFG "));
+    Serial.print(int(AlarmState()));
+    Serial.print(' ');
+    Serial.print(int(alarmLatched));
+    Serial.print(' ');
+    Serial.print(int(alarmSilenced));
+    Serial.print(' ');
+    PrintNumber(Serial, alarmDevHigh);
+    Serial.print(' ');
+    PrintNumber(Serial, alarmDevLow);
+    Serial.print(' ');
+    PrintNumber(Serial, alarmRate);
+    Serial.print(' ');
+    PrintNumber(Serial, alarmOvershoot);
+    Serial.print(' ');
+    PrintNumber(Serial, alarmHorizon);
+    Serial.print(' ');
+    PrintNumber(Serial, alarmHyst);
+    Serial.print(' ');
+    Serial.println(int(alarmLatch));
+    sendAlarm=false;
+  }
+  if(sendConfig)
+  {
+    ConfigSend();
+    sendConfig=false;
+  }
+  if(sendResume)
+  {
+    SendResume();
+    sendResume=false;
+  }
+  if(sendReport)
+  {
+    Serial.print(F("RBE "));
+    Serial.print(int(reportMode));
+    for(byte i=0;i<3;i++)
+    {
+      Serial.print(' ');
+      PrintNumber(Serial, reportBand[i]);
+    }
+    Serial.print(' ');
+    Serial.println(reportBeat);
+    sendReport=false;
+  }
+  if(logDump) LogSend();
+  if(runningProfile && (reportMode==0 || serialProtocol==PROTOCOL_BUS)) SendProfile();
+}
+
+void SendDash()
+{
+  Serial.print(F("DASH "));
+  PrintNumber(Serial, setpoint);
+  Serial.print(' ');
+  PrintNumber(Serial, input); //"Error" if the input has failed
+  Serial.print(' ');
+  PrintNumber(Serial, output);
+  Serial.print(' ');
+  Serial.print(myPID.GetMode());
+  Serial.print(' ');
+  Serial.println(ackDash?1:0);
+  if(ackDash)ackDash=false;
+}
+
+void SendTune()
+{ //the tunings in use, which a gain schedule changes as it goes
+  Serial.print(F("TUNE "));
+  PrintNumber(Serial, myPID.GetKp());
+  Serial.print(' ');
+  PrintNumber(Serial, myPID.GetKi());
+  Serial.print(' ');
+  PrintNumber(Serial, myPID.GetKd());
+  Serial.print(' ');
+  Serial.print(myPID.GetDirection()); 
+  Serial.print(' ');
+  Serial.print(tuning?1:0);
+  Serial.print(' ');
+  PrintNumber(Serial, aTuneStep);
+  Serial.print(' ');
+  PrintNumber(Serial, aTuneNoise);
+  Serial.print(' ');
+  Serial.print(aTuneLookBack); 
+  Serial.print(' ');
+  Serial.print(ackTune?1:0);
+  Serial.print(' ');
+  PrintNumber(Serial, myPID.GetDerivativeFilter());
+  Serial.print(' ');
+  PrintNumber(Serial, myPID.GetSetpointWeightP());
+  Serial.print(' ');
+  PrintNumber(Serial, myPID.GetSetpointWeightD());
+  Serial.print(' ');
+  Serial.println(int(aTuneMethod));
+  if(ackTune)ackTune=false;
+}
+
+void SendProfile()
 {
+  Serial.print(F("PROF "));
+  Serial.print(int(curProfStep));
+  Serial.print(' ');
+  Serial.print(int(curType));
+  Serial.print(' ');
+  switch(curType)
+  {
   case 1: //ramp
     Serial.println((helperTime-now)); //time remaining
-     
-  break;
+    break;
   case 2: //wait
-    Serial.print(abs(input-setpoint));
-    Serial.print(" ");
-    Serial.println(curVal==0? -1 : float(now-helperTime));
-  break;  
+    PrintNumber(Serial, abs(input-setpoint));
+    Serial.print(' ');
+    if(curVal==0) Serial.println(-1);
+    else Serial.println(now-helperTime); //ms waited so far.  a float runs out at about 6 hours
+    break;  
   case 3: //step
     Serial.println(curTime-(now-helperTime));
-  break;
+    break;
   default: 
-  break;
-  
-}
-
+    Serial.println();
+    break;
   }
-  
 }
-
-
-
-
-
-
-
-
-
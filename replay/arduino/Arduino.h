@@ -0,0 +1,156 @@
+#ifndef Arduino_h
+#define Arduino_h
+/*******************************************************************************
+* Just enough of the Arduino core for the firmware to build and run on the PC.
+* time only moves when the replay tool moves it (see replay.cpp.)
+*******************************************************************************/
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+#include "avr/pgmspace.h"
+#include "avr/io.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef unsigned int word;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+enum { A0 = 14, A1, A2, A3, A4, A5, A6, A7 };
+
+#define DEC 10
+#define HEX 16
+
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+#undef abs
+#define abs(x) ((x)>0?(x):-(x))
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+#define lowByte(w) ((uint8_t) ((w) & 0xff))
+#define highByte(w) ((uint8_t) ((w) >> 8))
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+
+extern uint32_t replayMillis;
+extern int replayAnalog[24];
+extern uint8_t replayPins[24];
+
+inline uint32_t millis() { return replayMillis; }
+#ifdef USE_BENCHMARK
+uint32_t micros(); //the PC's own clock, for timing
+#else
+inline uint32_t micros() { return replayMillis * 1000UL; }
+#endif
+inline void delay(uint32_t ms) { replayMillis += ms; }
+inline void delayMicroseconds(unsigned int) {}
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t pin, uint8_t val) { replayPins[pin % 24] = val; }
+inline int digitalRead(uint8_t pin) { return replayPins[pin % 24]; }
+inline int analogRead(uint8_t pin) { return replayAnalog[pin % 24]; }
+inline void analogWrite(uint8_t, int) {}
+inline void cli() {}
+inline void sei() {}
+inline void noInterrupts() {}
+inline void interrupts() {}
+int32_t random(int32_t howsmall, int32_t howbig);
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(PSTR(string_literal)))
+
+// formats numbers the way the AVR core does, so serial output matches
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t) = 0;
+  size_t write(const char *s) { size_t n = 0; while(*s) n += write((uint8_t)*s++); return n; }
+  size_t print(const __FlashStringHelper *s) { return write((const char *)s); }
+  size_t print(const char *s) { return write(s); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(unsigned char b, int base = DEC) { return printNumber(b, base); }
+  size_t print(int16_t n, int base = DEC) { return print((int32_t)n, base); }
+  size_t print(uint16_t n, int base = DEC) { return printNumber(n, base); }
+  size_t print(int32_t n, int base = DEC)
+  {
+    if(base == DEC && n < 0) return print('-') + printNumber(-(uint32_t)n, DEC);
+    return printNumber((uint32_t)n, base);
+  }
+  size_t print(uint32_t n, int base = DEC) { return printNumber(n, base); }
+  size_t print(float n, int digits = 2) { return printFloat(n, digits); }
+  size_t println() { return write("\r\n"); }
+  template<class T> size_t println(T v) { size_t n = print(v); return n + println(); }
+  template<class T> size_t println(T v, int b) { size_t n = print(v, b); return n + println(); }
+private:
+  size_t printNumber(uint32_t n, uint8_t base)
+  {
+    char buf[33];
+    char *str = &buf[sizeof(buf) - 1];
+    *str = '\0';
+    do
+    {
+      char c = n % base;
+      n /= base;
+      *--str = c < 10 ? c + '0' : c + 'A' - 10;
+    } while(n);
+    return write(str);
+  }
+  size_t printFloat(float number, uint8_t digits)
+  {
+    size_t n = 0;
+    if(isnan(number)) return print("nan");
+    if(isinf(number)) return print("inf");
+    if(number > 4294967040.0f || number < -4294967040.0f) return print("ovf");
+    if(number < 0.0f)
+    {
+      n += print('-');
+      number = -number;
+    }
+    float rounding = 0.5f;
+    for(uint8_t i = 0; i < digits; ++i) rounding /= 10.0f;
+    number += rounding;
+    uint32_t intPart = (uint32_t)number;
+    float remainder = number - (float)intPart;
+    n += print(intPart);
+    if(digits > 0) n += print('.');
+    while(digits-- > 0)
+    {
+      remainder *= 10.0f;
+      unsigned int toPrint = (unsigned int)remainder;
+      n += print((uint32_t)toPrint);
+      remainder -= toPrint;
+    }
+    return n;
+  }
+};
+
+// bytes from the trace go through a 64 byte receive buffer, as on the chip
+// (see SerialFeed in replay.cpp), and whatever the firmware sends is
+// collected a line at a time
+class HardwareSerial : public Print
+{
+public:
+  void begin(uint32_t) {}
+  void flush() {}
+  int available();
+  int read();
+  int peek();
+  size_t write(uint8_t c);
+  operator bool() { return true; }
+  uint8_t rx[64];
+  int rxHead, rxCount;
+};
+extern HardwareSerial Serial;
+
+/*on the AVR long is 32 bits and double is the same as float.  narrow both
+  here so the arithmetic, and with it the output, matches the controller*/
+#define long int
+#define double float
+
+#endif
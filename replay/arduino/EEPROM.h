@@ -0,0 +1,16 @@
+#ifndef EEPROM_h
+#define EEPROM_h
+#include <stdint.h>
+
+// 1KB like the ATmega328. starts erased (0xFF) unless an image is loaded
+struct EEPROMClass
+{
+  uint8_t mem[1024];
+  uint8_t read(int a) { return mem[a & 1023]; }
+  void write(int a, uint8_t v) { mem[a & 1023] = v; }
+  void update(int a, uint8_t v) { if(mem[a & 1023] != v) write(a, v); }
+  int length() { return 1024; }
+};
+extern EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef LiquidCrystal_h
+#define LiquidCrystal_h
+#include "Arduino.h"
+
+// keeps what would be on the 16x2 display
+class LiquidCrystal : public Print
+{
+public:
+  LiquidCrystal(uint8_t, uint8_t, uint8_t, uint8_t, uint8_t, uint8_t) { clear(); }
+  void begin(uint8_t, uint8_t) {}
+  void clear() { memset(screen, ' ', sizeof(screen)); col = row = 0; }
+  void setCursor(uint8_t c, uint8_t r) { col = c; row = r; }
+  void cursor() {}
+  void noCursor() {}
+  size_t write(uint8_t c)
+  {
+    if(row < 2 && col < 16) screen[row][col] = c;
+    col++;
+    return 1;
+  }
+  char screen[2][16];
+  uint8_t col, row;
+};
+
+#endif
@@ -0,0 +1,5 @@
+#ifndef INTERRUPT_h
+#define INTERRUPT_h
+// interrupt handlers become ordinary functions nothing calls
+#define ISR(vector) void vector(void)
+#endif
@@ -0,0 +1,21 @@
+#ifndef IO_h
+#define IO_h
+#include <stdint.h>
+
+// just the registers the firmware touches
+extern uint8_t MCUSR, WDTCSR;
+#define PORF 0
+#define EXTRF 1
+#define BORF 2
+#define WDRF 3
+#define WDP0 0
+#define WDP1 1
+#define WDP2 2
+#define WDE 3
+#define WDCE 4
+#define WDP3 5
+#define WDIE 6
+#define WDIF 7
+#define _BV(b) (1 << (b))
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef PGMSPACE_h
+#define PGMSPACE_h
+#include <string.h>
+#include <stdint.h>
+
+// on the PC flash and RAM are the same thing
+#define PROGMEM
+#define PSTR(s) (s)
+#define PGM_P const char *
+// memcpy rather than a cast: the sketch reads int tables a word at a time,
+// which the compiler may assume never happens
+static inline uint16_t pgm_read_word_(const void *a){ uint16_t v; memcpy(&v, a, 2); return v; }
+static inline uint32_t pgm_read_dword_(const void *a){ uint32_t v; memcpy(&v, a, 4); return v; }
+static inline float pgm_read_float_(const void *a){ float v; memcpy(&v, a, 4); return v; }
+#define pgm_read_byte(a) (*(const uint8_t *)(a))
+#define pgm_read_word(a) pgm_read_word_(a)
+#define pgm_read_dword(a) pgm_read_dword_(a)
+#define pgm_read_float(a) pgm_read_float_(a)
+#define pgm_read_ptr(a) (*(void * const *)(a))
+#define memcpy_P memcpy
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strlen_P strlen
+
+#endif
@@ -0,0 +1,5 @@
+#ifndef DELAY_h
+#define DELAY_h
+inline void _delay_ms(double) {}
+inline void _delay_us(double) {}
+#endif
@@ -0,0 +1,10 @@
+#!/bin/sh
+# builds the firmware with USE_BENCHMARK, runs it on the PC and writes
+# name,calls,total_us,us_per_call lines to replay/build/bench.csv (or $1)
+set -e
+R=$(cd "$(dirname "$0")" && pwd)
+OUT=${1:-$R/build/bench.csv}
+NAME=bench "$R/build.sh" -DUSE_BENCHMARK
+"$R/build/bench" -t 0 /dev/null |
+  awk -F' ' '/,s,BENCH [^D]/ { sub(/^.*,s,/, ""); printf "%s,%s,%s,%.3f\n", $2, $3, $4, $4 / $3 }' > "$OUT"
+cat "$OUT"
@@ -0,0 +1,12 @@
+#!/bin/sh
+# builds the replay tool into replay/build/replay
+# usage: replay/build.sh [extra compiler flags, -DUSE_SIMULATION for instance]
+# set NAME to build under another name (bench.sh does)
+set -e
+R=$(cd "$(dirname "$0")" && pwd)
+S=$R/../osPID_Firmware
+O=$R/build
+mkdir -p "$O"
+python3 "$R/sketch.py" "$S/osPID_Firmware.ino" "$O/sketch.cpp"
+${CXX:-c++} -O2 -Wall -DARDUINO=105 -DUSE_REPLAY -I"$R/arduino" -I"$S" "$@" \
+  -o "$O/${NAME:-replay}" "$R/replay.cpp" "$O/sketch.cpp" "$S"/*.cpp -lm
@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+# Simulates a number of osPIDs sharing one RS-485 line in the addressed bus
+# mode and works out how long a host takes to poll every one of them.
+# usage: bus_sim.py [-n units] [-b baud] [-c cycles] [-g host-gap-ms] [-r replay]
+#
+# every unit is its own replay run (build with -DUSE_SIMULATION so they have a
+# process to control) and sees all the traffic on the line, as it would on a
+# real bus.  the replay clock moves bytes instantly, so the wire time of each
+# request and answer is added here: a first pass measures how long each unit
+# takes to start answering and how long the answers are, a second pass polls
+# on the timeline that gives and checks that only the addressed unit answers,
+# inside its slot.  halfway through, a broadcast moves every setpoint.
+import subprocess, sys, os, struct, math, getopt
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+
+def run(replay, trace_path, lines):
+    with open(trace_path, 'w') as f:
+        f.write('\n'.join(lines) + '\n')
+    out = subprocess.run([replay, '-x', trace_path], check=True,
+                         stdout=subprocess.PIPE, universal_newlines=True).stdout
+    sent = []
+    for rec in out.splitlines():
+        ms, kind, data = rec.split(',', 2)
+        if kind == 'x':
+            sent.append((int(ms), bytes.fromhex(data)))
+    return sent
+
+
+def simulate(replay, units, schedule, workdir):
+    """schedule: [(ms, frame bytes)] on the line.  returns what each unit sent."""
+    traffic = ['%d,s,%s' % (ms, frame.hex()) for ms, frame in schedule]
+    result = {}
+    for addr in range(1, units + 1):
+        switch = '1000,s,%s' % bytes([16, 2, addr]).hex()  #Processing protocol -> bus
+        result[addr] = run(replay, os.path.join(workdir, 'bus_%d.csv' % addr), [switch] + traffic)
+    return result
+
+
+def answers(result, schedule):
+    """for each frame on the line: [(unit, ms, bytes)] sent before the next one"""
+    out = []
+    for i, (ms, _) in enumerate(schedule):
+        end = schedule[i + 1][0] if i + 1 < len(schedule) else float('inf')
+        got = []
+        for addr, sent in result.items():
+            b = b''.join(d for t, d in sent if ms <= t < end)
+            if b:
+                got.append((addr, min(t for t, d in sent if ms <= t < end) - ms, b))
+        out.append(got)
+    return out
+
+
+def main():
+    opts, _ = getopt.getopt(sys.argv[1:], 'n:b:c:g:r:')
+    opts = dict(opts)
+    units = int(opts.get('-n', 8))
+    baud = int(opts.get('-b', 9600))
+    cycles = int(opts.get('-c', 4))
+    char_ms = 10000.0 / baud  #8N1
+    gap = float(opts.get('-g', 3.5 * char_ms))
+    replay = opts.get('-r', os.path.join(HERE, 'build', 'replay'))
+    workdir = os.path.dirname(replay)
+
+    #setup: every unit leaves the TUNE line out of its answers, and gets the
+    #one-off lines (version, card config) out of the way
+    setup = [(2000 + 300 * i, bytes([a, 0, 2, 0])) for i, a in enumerate(range(1, units + 1))]
+    start = setup[-1][0] + 1000
+    broadcast = bytes([0, 1, 1]) + struct.pack('<3f', 300, 0, 0)
+
+    def polls(times):
+        sched, k = [], 0
+        for c in range(cycles):
+            if c == cycles // 2:
+                sched.append((times[k], broadcast))
+                k += 1
+            for a in range(1, units + 1):
+                sched.append((times[k], bytes([a])))
+                k += 1
+        return sched
+
+    n = cycles * units + 1
+    first = polls([start + 200 * i for i in range(n)])
+    got = answers(simulate(replay, units, setup + first, workdir), setup + first)[len(setup):]
+
+    #the timeline a real line would allow
+    times, t = [], start
+    for (_, frame), ans in zip(first, got):
+        times.append(t)
+        busy = len(frame) * char_ms
+        if ans:
+            busy += ans[0][1] + len(ans[0][2]) * char_ms
+        t += int(math.ceil(busy + gap))
+    second = polls(times)
+    got = answers(simulate(replay, units, setup + second, workdir), setup + second)[len(setup):]
+
+    answered = wrong = late = 0
+    reached = set()
+    worst = 0
+    for i, ((ms, frame), ans) in enumerate(zip(second, got)):
+        if frame[0] == 0:
+            if ans:
+                wrong += 1
+            continue
+        for addr, delay, data in ans:
+            if addr != frame[0] or not data.decode('latin-1').rstrip().endswith('END %d' % addr):
+                wrong += 1
+                continue
+            answered += 1
+            done = len(frame) * char_ms + delay + len(data) * char_ms
+            worst = max(worst, done)
+            if i + 1 < len(second) and ms + done > second[i + 1][0]:
+                late += 1
+            if i > len(second) - units - 1 and b'DASH 300.00' in data:
+                reached.add(addr)
+
+    cycle = t - times[-units]  #the last round of polls
+    print('%d units at %d baud, %.1f ms host gap' % (units, baud, gap))
+    print('poll cycle %.0f ms (%.1f ms per unit), slowest answer complete %.1f ms after the poll'
+          % (cycle, cycle / units, worst))
+    print('polls answered %d/%d, wrong or extra answers %d, answers overrunning their slot %d'
+          % (answered, cycles * units, wrong, late))
+    print('broadcast setpoint reached %d/%d units' % (len(reached), units))
+    return 0 if answered == cycles * units and not wrong and not late and len(reached) == units else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
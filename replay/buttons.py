@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+# Checks the button driver against synthetic ADC waveforms: presses that
+# bounce at both edges with noise on top, held presses for the auto-repeat,
+# and a long press on return.  the driver's events can't be seen directly,
+# so it watches what they do to the setpoint being edited on the dashboard.
+# usage: buttons.py [-r replay/build/replay] [-s seed]
+import subprocess, sys, os, struct, random, getopt
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+LEVELS = {'none': 1023, 'return': 0, 'up': 253, 'down': 454, 'ok': 657}
+NOISE = 8       #ADC counts, standard deviation
+BOUNCE = 15     #ms of contact bounce at each edge
+
+
+class Waveform:
+    def __init__(self, rng):
+        self.rng = rng
+        self.t = 2000
+        self.records = []
+
+    def level(self, v):
+        if v != 1023:
+            v = int(round(v + self.rng.gauss(0, NOISE)))
+        self.records.append('%d,b,%d' % (self.t, max(0, min(1023, v))))
+        self.t += 1
+
+    def press(self, name, ms, gap=300):
+        for i in range(ms):
+            edge = i < BOUNCE or i >= ms - BOUNCE
+            self.level(1023 if edge and self.rng.random() < 0.5 else LEVELS[name])
+        self.records.append('%d,b,none' % self.t)
+        self.t += gap
+
+    def mark(self):
+        return self.t
+
+
+def run(replay, records, workdir):
+    trace = os.path.join(workdir, 'buttons.csv')
+    eeprom = os.path.join(workdir, 'buttons.bin')
+    with open(trace, 'w') as f:
+        f.write('\n'.join(records) + '\n')
+    out = subprocess.run([replay, '-E', eeprom, trace], check=True,
+                         stdout=subprocess.PIPE, universal_newlines=True).stdout
+    setpoint = []  #(ms, setpoint) from the io records
+    for rec in out.splitlines():
+        f = rec.split(',')
+        if f[1] == 'o':
+            setpoint.append((int(f[0]), float(f[3])))
+    saved = struct.unpack('<f', open(eeprom, 'rb').read()[15:19])[0]  #dash: mode, setpoint
+    return setpoint, saved
+
+
+def at(setpoint, ms):
+    return [v for t, v in setpoint if t <= ms][-1]
+
+
+def main():
+    opts = dict(getopt.getopt(sys.argv[1:], 'r:s:')[0])
+    replay = opts.get('-r', os.path.join(HERE, 'build', 'replay'))
+    w = Waveform(random.Random(int(opts.get('-s', 1))))
+
+    w.press('ok', 200)                  #into the dashboard, setpoint highlighted
+    w.press('ok', 200)                  #edit it, hundreds digit
+    w.press('ok', 200)
+    w.press('ok', 200)                  #ones digit
+    start = w.mark()
+    for _ in range(5):
+        w.press('up', 150)              #short presses: one step each
+    taps = w.mark()
+    w.press('up', 4000, gap=500)        #held: repeats, faster and faster
+    held = w.mark()
+    w.press('return', 1500)             #long press: out of editing and the menu
+    w.t += 1000
+    w.records.append('%d,b,none' % w.t)
+
+    setpoint, saved = run(replay, w.records, os.path.dirname(replay))
+    base = at(setpoint, start)
+    tapped = at(setpoint, taps) - base
+    last = at(setpoint, held)
+    #every event moves the ones digit by 1, so the setpoint counts them
+    rate = [at(setpoint, taps + 1000 * (i + 1)) - at(setpoint, taps + 1000 * i) for i in range(4)]
+    print('5 bouncing taps moved the setpoint %g (want 5)' % tapped)
+    print('held for 4s: %g steps, per second %s' % (last - at(setpoint, taps), ' '.join('%g' % r for r in rate)))
+    print('setpoint %g, saved by the long return press: %g' % (last, saved))
+    ok = tapped == 5 and rate == sorted(rate) and rate[-1] > rate[1] and saved == last
+    print('ok' if ok else 'FAILED')
+    return 0 if ok else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,17 @@
+#!/bin/sh
+# builds the firmware with every input and output card combination and runs
+# a trace through each, leaving the results in replay/build/cards/
+# usage: replay/cards.sh trace.csv [extra compiler flags]
+# a card that stops compiling, or a combination that fails to run, stops it
+set -e
+R=$(cd "$(dirname "$0")" && pwd)
+TRACE=$1
+shift
+mkdir -p "$R/build/cards"
+for IN in TEMP_INPUT_V110 TEMP_INPUT_V120 PROTOTYPE_INPUT; do
+  for OUT in DIGITAL_OUTPUT_V120 DIGITAL_OUTPUT_V150 PROTOTYPE_OUTPUT; do
+    NAME=cards/replay_${IN}_${OUT} "$R/build.sh" -D$IN -D$OUT "$@"
+    "$R/build/cards/replay_${IN}_${OUT}" "$TRACE" > "$R/build/cards/${IN}_${OUT}.csv"
+    echo "$IN $OUT: $(grep -c '' "$R/build/cards/${IN}_${OUT}.csv") records"
+  done
+done
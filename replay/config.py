@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+# Checks writing a config snapshot the way a host would: reads one back
+# (info request 12), changes the setpoint in it and sends the lot, header and
+# blob in one go, over the Processing protocol and then the addressed bus.
+# the replay tool's 64 byte receive buffer loses whatever the firmware
+# doesn't read in time, as the chip would, so the blob only gets through if
+# the header is noticed straight away.  one sent while autotuning has to be
+# refused (the blob is read into the autotune's history), and taken in
+# whole all the same.  then it restarts the controller as if
+# the power had gone partway through the write (the marker still set in the
+# EEPROM image) and checks it comes up on the defaults, not a mix.
+# usage: config.py [-r replay/build/replay]
+import subprocess, sys, os, struct, getopt
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+SETPOINT = 2 + 13 + 12 + 1  #version and length, the tunings, filter, then the mode
+MARKER = 574  #eepromConfigOffset
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+    return crc
+
+
+def run(replay, workdir, name, lines, eeprom_in=None):
+    trace = os.path.join(workdir, name + '.csv')
+    eeprom = os.path.join(workdir, name + '.bin')
+    with open(trace, 'w') as f:
+        f.write('\n'.join(lines) + '\n')
+    args = [replay, '-E', eeprom] + (['-e', eeprom_in] if eeprom_in else []) + [trace]
+    res = subprocess.run(args, check=True, stdout=subprocess.PIPE,
+                         stderr=subprocess.PIPE, universal_newlines=True)
+    sent = [rec.split(',', 2)[2] for rec in res.stdout.splitlines() if ',s,' in rec]
+    return sent, res.stderr
+
+
+def answer(sent, prefix):
+    return [line[len(prefix):] for line in sent if line.startswith(prefix)]
+
+
+def main():
+    opts = dict(getopt.getopt(sys.argv[1:], 'r:')[0])
+    replay = opts.get('-r', os.path.join(HERE, 'build', 'replay'))
+    workdir = os.path.dirname(replay)
+
+    sent, _ = run(replay, workdir, 'cfg0', ['1000,s,000c01'])
+    defaults = bytes.fromhex(answer(sent, 'CFG ')[0])
+    blob = bytearray(defaults)
+    blob[SETPOINT:SETPOINT + 4] = struct.pack('<f', 123.5)
+    crc = crc16(blob[:-2])
+    blob[-2:] = bytes([crc & 0xFF, crc >> 8])
+
+    autotune = '1500,s,0301' + struct.pack('<fff', 20, 1, 10).hex()
+    ok = True
+    for name, lines, expect in (
+            ('processing', ['1500,s,1101' + blob.hex(), '3000,s,000c01'], blob),
+            ('bus', ['1500,s,100201', '2000,s,011101' + blob.hex(), '3000,s,01000c01'], blob),
+            ('tuning', ['1000,i,25', autotune, '2000,s,1101' + blob.hex(), '3000,s,000c01'], defaults)):
+        sent, err = run(replay, workdir, 'cfg_' + name, lines)
+        ack = answer(sent, 'CFGACK ')
+        back = answer(sent, 'CFG ')
+        want = '0' if expect is blob else '4'
+        got = ack == [want] and not err and back and bytes.fromhex(back[-1]) == bytes(expect)
+        print('%-10s  CFGACK %s  %s  %s' % (name, ' '.join(ack) or '-',
+                                           err.strip() or 'nothing lost',
+                                           'as it should be' if got else 'WRONG'))
+        ok = ok and got
+
+    with open(os.path.join(workdir, 'cfg_processing.bin'), 'rb') as f:
+        image = bytearray(f.read())
+    marker_clear = image[MARKER] == 0
+    image[MARKER] = 0xA5
+    cut = os.path.join(workdir, 'cfg_power_cut.bin')
+    with open(cut, 'wb') as f:
+        f.write(image)
+    sent, _ = run(replay, workdir, 'cfg_restart', ['1000,s,000c01'], cut)
+    with open(os.path.join(workdir, 'cfg_restart.bin'), 'rb') as f:
+        marker_clear = marker_clear and f.read()[MARKER] == 0
+    back = answer(sent, 'CFG ')
+    got = bool(back) and bytes.fromhex(back[0]) == defaults and marker_clear
+    print('cut short   %s' % ('back to the defaults' if got else 'NOT RECOVERED'))
+    ok = ok and got
+    print('ok' if ok else 'FAILED')
+    return 0 if ok else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,22 @@
+/*******************************************************************************
+* MAX31855Linearize on the PC, for thermocouple.py
+* reads "type thermocouple-count junction-count" lines and prints
+* "fault celsius-count" for each.  counts are as readCounts gives them
+*******************************************************************************/
+#include "Arduino.h"
+#include "MAX31855_local.h"
+
+uint32_t replayMillis = 0;
+uint8_t replayPins[24];
+
+int main()
+{
+  int type, thermocouple, junction;
+  while(scanf("%d %d %d", &type, &thermocouple, &junction) == 3)
+  {
+    int celsius = 0;
+    int fault = MAX31855Linearize((thermocouple_t)type, thermocouple, junction, &celsius);
+    printf("%d %d\n", fault, celsius);
+  }
+  return 0;
+}
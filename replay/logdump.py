@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+# Checks the data logger end to end: logs a wandering input once a second,
+# resets the controller partway through (a second replay run starting from
+# the first one's EEPROM), then downloads the ring, decodes it and compares
+# every record with what the firmware was actually doing at the time.
+# usage: logdump.py [-r replay/build/replay] [-s seed]
+#
+# the ring format is described above LogStartBlock in osPID_Firmware.ino.
+import subprocess, sys, os, struct, math, random, getopt
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+BLOCK = 64
+
+
+def varint(b, pos):
+    val = shift = 0
+    while True:
+        c = b[pos]
+        pos += 1
+        val |= (c & 0x7F) << shift
+        shift += 7
+        if not c & 0x80 or pos >= len(b):
+            return val, pos
+
+
+def decode(blocks):
+    """blocks, oldest first -> [(boot, seconds since boot, [input, setpoint, output])]
+    a boot counter goes up at every reset the log shows: a time mark, or a
+    block starting before the one it follows"""
+    records, boot, last_t = [], 0, -1
+    for b in blocks:
+        interval, pos = varint(b, 1)
+        t, pos = varint(b, pos)
+        if t < last_t:
+            boot += 1
+        vals = [0, 0, 0]
+        first = True
+        while pos < BLOCK and b[pos] != 0xFF:
+            mask = b[pos]
+            pos += 1
+            if mask & 16:
+                t, pos = varint(b, pos)
+                boot += 1
+                records.append(None)  #where the reset was
+            elif not first:
+                t += interval
+            first = False
+            for i in range(3):
+                if mask & (1 << i):
+                    z, pos = varint(b, pos)
+                    vals[i] += (z >> 1) ^ -(z & 1)
+            got = [v / 10.0 for v in vals]
+            if mask & 8:
+                got[0] = float('nan')
+            records.append((boot, t, got))
+        last_t = t
+    return records
+
+
+def run(replay, workdir, name, lines, eeprom_in=None):
+    trace = os.path.join(workdir, name + '.csv')
+    eeprom = os.path.join(workdir, name + '.bin')
+    with open(trace, 'w') as f:
+        f.write('\n'.join(lines) + '\n')
+    args = [replay, '-x', '-E', eeprom] + (['-e', eeprom_in] if eeprom_in else []) + [trace]
+    out = subprocess.run(args, check=True, stdout=subprocess.PIPE, universal_newlines=True).stdout
+    io, sent = [], b''
+    for rec in out.splitlines():
+        ms, kind, data = rec.split(',', 2)
+        if kind == 'o':
+            io.append((int(ms), [float(v) for v in data.split(',')]))
+        elif kind == 'x':
+            sent += bytes.fromhex(data)
+    return io, sent, eeprom
+
+
+def inputs(rng, start, end, gap):
+    """a slow wander with noise, failing for a few seconds at gap"""
+    lines, v = [], 25.0
+    for ms in range(start, end, 250):
+        v += rng.gauss(0, 0.3)
+        failed = gap <= ms < gap + 4000
+        lines.append('%d,i,%s' % (ms, 'nan' if failed else '%.2f' % v))
+    return lines
+
+
+def matches(io, t, got):
+    for ms, vals in io:
+        if ms // 1000 != t:
+            continue
+        if all((math.isnan(g) and math.isnan(v)) or abs(g - v) <= 0.0501
+               for g, v in zip(got, vals)):
+            return True
+    return False
+
+
+def main():
+    opts = dict(getopt.getopt(sys.argv[1:], 'r:s:')[0])
+    replay = opts.get('-r', os.path.join(HERE, 'build', 'replay'))
+    workdir = os.path.dirname(replay)
+    rng = random.Random(int(opts.get('-s', 1)))
+
+    every_second = '1000,s,0b00' + struct.pack('<f', 1.0).hex()
+    io1, _, eeprom = run(replay, workdir, 'log1', [every_second] + inputs(rng, 1000, 90000, 40000))
+    lines = inputs(rng, 1000, 50000, 20000) + ['50000,s,0b01']
+    io2, sent, _ = run(replay, workdir, 'log2', lines, eeprom)
+
+    blocks, pos = [], 0
+    while True:
+        pos = sent.find(b'LOGB ', pos)
+        if pos < 0:
+            break
+        pos = sent.index(b' ', pos + 5) + 1
+        blocks.append(sent[pos:pos + BLOCK])
+        pos += BLOCK
+    records = decode(blocks)
+    reset = records.index(None) if None in records else -1
+    records = [r for r in records if r]
+
+    bad = [r for r in records if not matches((io1, io2)[min(r[0], 1)], r[1], r[2])]
+    used = sum(BLOCK - b.count(b'\xff') for b in blocks)
+    print('%d blocks, %d records, %.1f bytes a record (%d raw)' %
+          (len(blocks), len(records), used / max(1, len(records)), 16))
+    print('before the reset: %d, after: %d' %
+          (sum(r[0] == 0 for r in records), sum(r[0] == 1 for r in records)))
+    print('reset time-marked in the block it interrupted: %s' %
+          (reset > 0 and records[reset - 1][0] == 0))
+    for r in bad[:5]:
+        print('no match: boot %d, %ds, %s' % (r[0], r[1], r[2]))
+    ok = (not bad and b'LOG_DN' in sent and reset > 0 and
+          any(r[0] == 0 for r in records) and any(r[0] == 1 for r in records))
+    print('ok' if ok else 'FAILED')
+    return 0 if ok else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
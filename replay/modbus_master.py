@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+# Stands in for a Modbus master: turns a script of requests into a trace,
+# runs it through the replay tool and decodes what the firmware answered.
+# usage: modbus_master.py [-r replay/build/replay] [-e eeprom.bin] script.txt
+#
+# script lines are "ms request", one per line, # for comments:
+#   1000 legacy 1 1      Processing protocol identifier 16: switch to Modbus
+#                        (1), at slave address 1
+#   2000 4 0 9           function 3 or 4: read, first register, count
+#   2500 6 0 3000        function 6 (or any other but 16): register, value
+#   3000 16 4 20,50,0    function 16: write registers, first register, values
+#   3500 raw 01030000    bytes as they are, no crc added (for broken frames)
+#   4000 input 25.5      not a request: the input reading from here on
+# requests go to address 1; put "@n" after the time ("2000 @2 4 0 9") for
+# another, @0 for a broadcast.  values are 16 bit, negative ones are sent as
+# two's complement.
+#
+# a request can end in "= answer", the decoded answer it should get, as
+# printed ("= regs 250 600 0", "= exception 3", "= no reply".)  with any of
+# those in the script it ends with ok or FAILED, and exits 1 on a mismatch.
+# replay/modbus_check.txt is one, covering every kind of request.
+import subprocess, sys, os
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+    return crc
+
+
+def frame(body):
+    c = crc16(body)
+    return bytes(body) + bytes([c & 0xFF, c >> 8])
+
+
+def u16(v):
+    return [(v >> 8) & 0xFF, v & 0xFF]
+
+
+def request(words):
+    addr = 1
+    if words[0].startswith('@'):
+        addr = int(words[0][1:])
+        words = words[1:]
+    if words[0] == 'legacy':
+        return bytes([16, int(words[1]), int(words[2])]), 'legacy'
+    if words[0] == 'raw':
+        return bytes.fromhex(words[1]), 'raw'
+    if words[0] == 'input':
+        return words[1], 'input'
+    fn = int(words[0])
+    reg = int(words[1])
+    if fn == 16:
+        vals = [int(v) & 0xFFFF for v in words[2].split(',')]
+        body = [addr, fn] + u16(reg) + u16(len(vals)) + [2 * len(vals)]
+        for v in vals:
+            body += u16(v)
+        return frame(body), 'modbus'
+    #3, 4 and 6, and any other function with the same layout
+    return frame([addr, fn] + u16(reg) + u16(int(words[2]) & 0xFFFF)), 'modbus'
+
+
+def decode(req, reply):
+    if not reply:
+        return 'no reply'
+    if len(reply) < 5 or crc16(reply[:-2]) != reply[-2] | (reply[-1] << 8):
+        return 'bad frame ' + reply.hex()
+    fn = reply[1]
+    if fn & 0x80:
+        return 'exception %d' % reply[2]
+    if fn in (3, 4):
+        vals = [reply[3 + 2 * i] << 8 | reply[4 + 2 * i] for i in range(reply[2] // 2)]
+        return 'regs ' + ' '.join(str(v - 65536 if v >= 32768 else v) for v in vals)
+    return 'ok ' + reply[2:-2].hex()
+
+
+def main(argv):
+    replay = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'build', 'replay')
+    extra = []
+    args = argv[1:]
+    while args and args[0].startswith('-'):
+        if args[0] == '-r':
+            replay = args[1]
+        elif args[0] == '-e':
+            extra += ['-e', args[1]]
+        else:
+            args = []
+            break
+        args = args[2:]
+    if len(args) != 1:
+        sys.exit('usage: modbus_master.py [-r replay] [-e eeprom.bin] script.txt')
+
+    reqs = []
+    for line in open(args[0]):
+        line, _, want = line.split('#')[0].partition('=')
+        line = line.split()
+        if line:
+            data, kind = request(line[1:])
+            reqs.append((int(line[0]), data, kind, want.strip()))
+    trace = os.path.join(os.path.dirname(replay), 'modbus_trace.csv')
+    with open(trace, 'w') as f:
+        for ms, data, kind, _ in reqs:
+            if kind == 'input':
+                f.write('%d,i,%s\n' % (ms, data))
+            else:
+                f.write('%d,s,%s\n' % (ms, data.hex()))
+
+    out = subprocess.run([replay, '-x'] + extra + [trace], check=True,
+                         stdout=subprocess.PIPE, universal_newlines=True).stdout
+    sent = []  #(ms, bytes) the firmware sent
+    for rec in out.splitlines():
+        ms, kind, data = rec.split(',', 2)
+        if kind == 'x':
+            sent.append((int(ms), bytes.fromhex(data)))
+
+    reqs = [r for r in reqs if r[2] != 'input']
+    checked = failed = 0
+    for i, (ms, data, kind, want) in enumerate(reqs):
+        end = reqs[i + 1][0] if i + 1 < len(reqs) else float('inf')
+        got = [(t, b) for t, b in sent if ms <= t < end]
+        if kind == 'legacy':
+            reply = b''.join(b for _, b in got)
+            print('%d legacy %s -> %r' % (ms, data.hex(), reply.decode('latin-1').strip()))
+            continue
+        reply = got[0][1] if got else b''  #an answer goes out in one piece
+        when = ' (%d ms)' % (got[0][0] - ms) if got else ''
+        answer = decode(data, reply)
+        print('%d %s -> %s%s' % (ms, data.hex(), answer, when))
+        if want:
+            checked += 1
+            if answer != want:
+                failed += 1
+                print('    expected %s' % want)
+    if not checked:
+        return 0
+    print('ok' if not failed else 'FAILED')
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
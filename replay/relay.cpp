@@ -0,0 +1,68 @@
+/*******************************************************************************
+* the digital output card's relay scheduling on the PC, for relay.py
+* runs an hour of a fixed output at each duty, with and without minimum
+* on/off times, sampling the relay pin every 250ms as the firmware's io does.
+* prints "min-on min-off duty measured-duty rises counted-cycles saved-cycles
+* shortest-on shortest-off" per run: saved is what the hourly save left in the
+* EEPROM, the shortest runs are in ms (-1 when there was no complete one)
+*******************************************************************************/
+#include "DigitalOutputCard_local.h"
+#include "EEPROMAnything.h"
+
+uint32_t replayMillis = 0;
+uint8_t replayPins[24];
+HardwareSerial Serial;
+EEPROMClass EEPROM;
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  return 1;
+}
+
+const int offset = 300;
+const byte relayPin = 5;
+
+int main()
+{
+  const double duties[] = { 0.5, 3, 10, 15, 50, 85, 90, 97, 99.5, 100 };
+  for(int mins = 0; mins < 2; mins++)
+  {
+    for(unsigned d = 0; d < sizeof(duties) / sizeof(duties[0]); d++)
+    {
+      DigitalOutputCard card;
+      card.outputType = 0;
+      card.SetWindow(10);
+      card.minOn = mins ? 2 : 0;
+      card.minOff = mins ? 3 : 0;
+      replayMillis = 1000;
+      card.BackupParams(offset); //the counts start from 0, and the hour from now
+
+      int samples = 0, on = 0, rises = 0, run = 0;
+      int shortest[2] = { -1, -1 }; //off, on
+      int last = -1;
+      bool edge = false; //a run only counts once it started at an edge
+      for(; replayMillis <= 1000 + 3600000UL; replayMillis += 250)
+      {
+        card.Write(duties[d]);
+        int pin = replayPins[relayPin];
+        if(pin != last)
+        {
+          if(edge && (shortest[last] < 0 || run < shortest[last])) shortest[last] = run;
+          if(last >= 0) edge = true;
+          if(pin) rises++;
+          last = pin;
+          run = 0;
+        }
+        run += 250;
+        on += pin;
+        samples++;
+      }
+      unsigned long saved; //32 bits, as on the AVR
+      EEPROM_readAnything(offset + 24, saved);
+      printf("%d %d %g %.3f %d %u %u %d %d\n", card.minOn, card.minOff, duties[d],
+             100.0 * on / samples, rises, (unsigned)card.relayCycles, (unsigned)saved,
+             shortest[1], shortest[0]);
+    }
+  }
+  return 0;
+}
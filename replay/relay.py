@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+# Checks the digital output card's relay over an hour at each of a range of
+# fixed outputs, with a 10s window, sampled every 250ms as the firmware's io
+# does.  with 2s minimum on and 3s minimum off times it checks that the relay
+# never switches quicker than that and still delivers the output asked for;
+# with none it checks the plain time proportioning.  either way the switching
+# count has to match the relay's rises, and the hourly save has to have
+# stored it.  relay.cpp drives the card.
+# usage: relay.py
+import subprocess, sys, os
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+FIRMWARE = os.path.join(HERE, '..', 'osPID_Firmware')
+WINDOW = 10000  #ms
+SAMPLE = 250
+
+
+def build():
+    exe = os.path.join(HERE, 'build', 'relay')
+    os.makedirs(os.path.dirname(exe), exist_ok=True)
+    subprocess.run([os.environ.get('CXX', 'c++'), '-O2', '-Wall', '-DARDUINO=105',
+                    '-I' + os.path.join(HERE, 'arduino'), '-I' + FIRMWARE, '-o', exe,
+                    os.path.join(HERE, 'relay.cpp'),
+                    os.path.join(FIRMWARE, 'DigitalOutputCard.cpp'),
+                    os.path.join(FIRMWARE, 'NumberFormat.cpp')], check=True)
+    return exe
+
+
+def main():
+    out = subprocess.run([build()], check=True, stdout=subprocess.PIPE,
+                         universal_newlines=True).stdout
+    bad = 0
+    print(' on/off  duty  got     cycles  shortest on/off (s)')
+    for line in out.splitlines():
+        f = line.split()
+        min_on, min_off = int(f[0]) * 1000, int(f[1]) * 1000
+        duty, got = float(f[2]), float(f[3])
+        rises, counted, saved = int(f[4]), int(f[5]), int(f[6])
+        shortest_on, shortest_off = int(f[7]), int(f[8])
+        problems = []
+        #with minimums the owed time carries over, so the hour averages out;
+        #without, each window is rounded to the io sample
+        allowed = 0.25 if min_on or min_off else 100.0 * SAMPLE / WINDOW
+        if abs(got - duty) > allowed:
+            problems.append('duty off by %.2f' % (got - duty))
+        if 0 <= shortest_on < min_on:
+            problems.append('on for only %dms' % shortest_on)
+        if 0 <= shortest_off < min_off:
+            problems.append('off for only %dms' % shortest_off)
+        if not rises == counted == saved:
+            problems.append('%d rises, counted %d, saved %d' % (rises, counted, saved))
+        bad += len(problems)
+        print('%3d/%-3d %5g %7.3f %5d  %6s/%-6s %s' %
+              (min_on / 1000, min_off / 1000, duty, got, counted,
+               '-' if shortest_on < 0 else '%g' % (shortest_on / 1000.0),
+               '-' if shortest_off < 0 else '%g' % (shortest_off / 1000.0),
+               ', '.join(problems)))
+    print('ok' if not bad else 'FAILED')
+    return 0 if not bad else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,305 @@
+/*******************************************************************************
+* osPID replay tool
+* runs the firmware on the PC against a recorded trace, on a virtual clock.
+* time jumps from one millisecond to the next as fast as the PC can call
+* loop(), so hours of trace take seconds, and the same trace always gives the
+* same result.  see README.txt for the trace and result formats.
+*******************************************************************************/
+#include "Arduino.h"
+#include "EEPROM.h"
+
+uint32_t replayMillis = 0;
+int replayAnalog[24];
+uint8_t replayPins[24];
+uint8_t MCUSR, WDTCSR;
+HardwareSerial Serial;
+EEPROMClass EEPROM;
+
+void setup();
+void loop();
+extern float setpoint, input, output;
+extern uint32_t ioTime;
+
+static FILE *result;
+static float traceInput = NAN;
+static char txLine[1024];
+static int txLen = 0;
+static bool txHex = false; //binary protocols: log what's sent as hex, a loop() at a time
+static uint32_t seed = 1;
+static uint8_t wire[1024]; //serial bytes on their way in
+static uint64_t wireDue[1024]; //when each one gets there, in microseconds
+static uint32_t wireHead = 0, wireTail = 0, serialLost = 0;
+static const uint32_t byteTime = 10000000UL / 9600; //microseconds a character takes
+
+// the firmware asks for a new input every time it would read the card
+float ReplayInput()
+{
+  return traceInput;
+}
+
+#ifdef USE_BENCHMARK
+uint32_t micros()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+#endif
+
+int32_t random(int32_t howsmall, int32_t howbig)
+{ //fixed generator so simulation runs repeat too
+  seed = seed * 1103515245UL + 12345UL;
+  if(howsmall >= howbig) return howsmall;
+  return howsmall + (int32_t)((seed >> 16) % (uint32_t)(howbig - howsmall));
+}
+
+static void FlushHex()
+{
+  if(!txLen) return;
+  fprintf(result, "%u,x,", replayMillis);
+  for(int i = 0; i < txLen; i++) fprintf(result, "%02x", (uint8_t)txLine[i]);
+  fprintf(result, "\n");
+  txLen = 0;
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  if(txHex)
+  {
+    if(txLen == sizeof(txLine)) FlushHex();
+    txLine[txLen++] = c;
+    return 1;
+  }
+  if(c == '\r') return 1;
+  if(c == '\n' || txLen == sizeof(txLine) - 1)
+  {
+    txLine[txLen] = 0;
+    fprintf(result, "%u,s,%s\n", replayMillis, txLine);
+    txLen = 0;
+    if(c == '\n') return 1;
+  }
+  txLine[txLen++] = c;
+  return 1;
+}
+
+static int hexDigit(char c)
+{
+  if(c >= '0' && c <= '9') return c - '0';
+  if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// the receive buffer is a ring the size of the chip's.  a byte that arrives
+// while it's full is lost, as it would be there
+static void SerialArrive(uint8_t c)
+{
+  if(Serial.rxCount == (int)sizeof(Serial.rx))
+  {
+    serialLost++;
+    return;
+  }
+  Serial.rx[(Serial.rxHead + Serial.rxCount++) % sizeof(Serial.rx)] = c;
+}
+
+// moves what's come down the line by now into the buffer
+static void SerialPump()
+{
+  while(wireTail < wireHead && wireDue[wireTail % sizeof(wire)] <= replayMillis * 1000ULL)
+  {
+    SerialArrive(wire[wireTail % sizeof(wire)]);
+    wireTail++;
+  }
+}
+
+int HardwareSerial::available()
+{
+  SerialPump();
+  return rxCount;
+}
+
+int HardwareSerial::read()
+{
+  SerialPump();
+  if(!rxCount) return -1;
+  uint8_t c = rx[rxHead];
+  rxHead = (rxHead + 1) % sizeof(rx);
+  rxCount--;
+  return c;
+}
+
+int HardwareSerial::peek()
+{
+  SerialPump();
+  return rxCount ? rx[rxHead] : -1;
+}
+
+// serial bytes, given as hex, for the firmware to pick up.  as much of a
+// record as the buffer has room for is taken to have just arrived; the rest
+// follows at 9600 baud, so a long one (a config snapshot) has to be read as
+// it comes in, the way it does on the chip
+static bool SerialFeed(const char *hex)
+{
+  uint64_t due = replayMillis * 1000ULL;
+  if(wireTail < wireHead && wireDue[(wireHead - 1) % sizeof(wire)] > due)
+    due = wireDue[(wireHead - 1) % sizeof(wire)];
+  while(hex[0] && hex[0] != '\n' && hex[0] != '\r')
+  {
+    int hi = hexDigit(hex[0]), lo = hexDigit(hex[1]);
+    if(hi < 0 || lo < 0 || wireHead - wireTail == sizeof(wire)) return false;
+    uint8_t c = hi * 16 + lo;
+    if(wireTail == wireHead && Serial.rxCount < (int)sizeof(Serial.rx)) SerialArrive(c);
+    else
+    {
+      due += byteTime;
+      wire[wireHead % sizeof(wire)] = c;
+      wireDue[wireHead % sizeof(wire)] = due;
+      wireHead++;
+    }
+    hex += 2;
+  }
+  return true;
+}
+
+// the buttons share one analog pin; these are the levels they pull it to.
+// a number is taken as the pin's reading itself, for bounce and noise
+static bool ButtonSet(const char *name)
+{
+  if(name[0] >= '0' && name[0] <= '9')
+  {
+    replayAnalog[A3 % 24] = atoi(name);
+    return true;
+  }
+  static const char *names[] = { "none", "return", "up", "down", "ok" };
+  static const int levels[] = { 1023, 0, 253, 454, 657 };
+  for(int i = 0; i < 5; i++)
+  {
+    if(strncmp(name, names[i], strlen(names[i])) == 0)
+    {
+      replayAnalog[A3 % 24] = levels[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool LoadEEPROM(const char *path)
+{
+  FILE *f = fopen(path, "rb");
+  if(!f) return false;
+  size_t n = fread(EEPROM.mem, 1, sizeof(EEPROM.mem), f);
+  fclose(f);
+  return n == sizeof(EEPROM.mem);
+}
+
+static bool SaveEEPROM(const char *path)
+{
+  FILE *f = fopen(path, "wb");
+  if(!f) return false;
+  size_t n = fwrite(EEPROM.mem, 1, sizeof(EEPROM.mem), f);
+  fclose(f);
+  return n == sizeof(EEPROM.mem);
+}
+
+static void usage()
+{
+  fprintf(stderr, "usage: replay [-e eeprom.bin] [-E eeprom-out.bin] [-t tail-ms] [-x] trace.csv\n");
+  exit(2);
+}
+
+int main(int argc, char **argv)
+{
+  const char *eepromIn = 0, *eepromOut = 0, *tracePath = 0;
+  uint32_t tail = 1000;
+  for(int i = 1; i < argc; i++)
+  {
+    if(!strcmp(argv[i], "-e") && i + 1 < argc) eepromIn = argv[++i];
+    else if(!strcmp(argv[i], "-E") && i + 1 < argc) eepromOut = argv[++i];
+    else if(!strcmp(argv[i], "-t") && i + 1 < argc) tail = strtoul(argv[++i], 0, 10);
+    else if(!strcmp(argv[i], "-x")) txHex = true;
+    else if(argv[i][0] != '-' && !tracePath) tracePath = argv[i];
+    else usage();
+  }
+  if(!tracePath) usage();
+
+  FILE *trace = fopen(tracePath, "r");
+  if(!trace)
+  {
+    fprintf(stderr, "replay: can't open %s\n", tracePath);
+    return 1;
+  }
+  memset(EEPROM.mem, 0xFF, sizeof(EEPROM.mem));
+  if(eepromIn && !LoadEEPROM(eepromIn))
+  {
+    fprintf(stderr, "replay: %s is not a 1024 byte eeprom image\n", eepromIn);
+    return 1;
+  }
+  result = stdout;
+  ButtonSet("none");
+
+  setup();
+
+  char line[600];
+  int lineNo = 0;
+  bool pending = false, done = false;
+  uint32_t at = 0, end = 0;
+  char kind = 0, data[512];
+  for(;;)
+  {
+    //apply every record that's due
+    for(;;)
+    {
+      if(!pending)
+      {
+        if(!fgets(line, sizeof(line), trace))
+        {
+          if(!done) end = replayMillis + tail;
+          done = true;
+          break;
+        }
+        lineNo++;
+        if(line[0] == '#' || line[0] == '\n' || line[0] == '\r') continue;
+        uint32_t t;
+        if(sscanf(line, "%u,%c,%511s", &t, &kind, data) != 3 || t < at)
+        {
+          fprintf(stderr, "replay: %s:%d: bad record\n", tracePath, lineNo);
+          return 1;
+        }
+        at = t;
+        pending = true;
+      }
+      if(at > replayMillis) break;
+      pending = false;
+      bool ok = true;
+      if(kind == 'i') traceInput = strtof(data, 0);
+      else if(kind == 's') ok = SerialFeed(data);
+      else if(kind == 'b') ok = ButtonSet(data);
+      else ok = false;
+      if(!ok)
+      {
+        fprintf(stderr, "replay: %s:%d: bad record\n", tracePath, lineNo);
+        return 1;
+      }
+    }
+    if(done && replayMillis >= end) break;
+
+    uint32_t lastIO = ioTime;
+    loop();
+    if(txHex) FlushHex();
+    if(ioTime != lastIO)
+    { //%.9g is enough to get a float back exactly
+      fprintf(result, "%u,o,%.9g,%.9g,%.9g\n", replayMillis,
+              (double)input, (double)setpoint, (double)output);
+    }
+    replayMillis++;
+  }
+  fclose(trace);
+  if(serialLost) fprintf(stderr, "replay: %u serial bytes lost to a full receive buffer\n", serialLost);
+
+  if(eepromOut && !SaveEEPROM(eepromOut))
+  {
+    fprintf(stderr, "replay: can't write %s\n", eepromOut);
+    return 1;
+  }
+  return 0;
+}
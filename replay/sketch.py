@@ -0,0 +1,24 @@
+# Turns the sketch into a plain C++ file the way the Arduino IDE does:
+# Arduino.h goes on top and every function gets a prototype after the
+# last #include, so functions can be used before they're defined.
+# usage: sketch.py osPID_Firmware.ino sketch.cpp
+import re, sys
+
+src = open(sys.argv[1]).read().split('\n')
+func = re.compile(r'^((?:static\s+|inline\s+|const\s+|unsigned\s+|signed\s+)*[A-Za-z_]\w*(?:\s*[\*&])*)'
+                  r'\s+(\**\w+)\s*\(([^;{}]*)\)\s*(\{.*)?$')
+protos = []
+for i, line in enumerate(src):
+    m = func.match(line)
+    if not m or m.group(1).split()[-1] in ('return', 'else', 'new', 'delete', 'case', 'typedef'):
+        continue
+    body = line.rstrip().endswith('{') or (i + 1 < len(src) and src[i + 1].strip().startswith('{'))
+    if not body:
+        continue
+    args = re.sub(r'=\s*[^,)]+', '', m.group(3))  #no default arguments in a prototype
+    protos.append('%s %s(%s);' % (m.group(1), m.group(2), args))
+
+last = max(i for i, line in enumerate(src) if line.startswith('#include')) + 1
+out = ['#include "Arduino.h"', '#line 1 "%s"' % sys.argv[1]] + src[:last]
+out += protos + ['#line %d' % (last + 1)] + src[last:]
+open(sys.argv[2], 'w').write('\n'.join(out) + '\n')
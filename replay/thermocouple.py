@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+# Checks MAX31855Linearize against the NIST ITS-90 reference tables: for each
+# type and reference point it works out what the chip would report (the
+# voltage at the chip's single sensitivity, less the cold junction's, as the
+# datasheet describes) with the cold junction at 0 and at 25C, runs that
+# through the firmware's linearization and compares with the true temperature.
+# usage: thermocouple.py
+import subprocess, sys, os
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+FIRMWARE = os.path.join(HERE, '..', 'osPID_Firmware')
+
+# uV per C the chip assumes (datasheet), and NIST ITS-90 emf in uV with the
+# reference junction at 0C, every 100C or so across each type's range
+TYPES = [
+    ('K', 41.276, {-200: -5891, -100: -3554, 0: 0, 25: 1000, 100: 4096, 200: 8138,
+                   300: 12209, 400: 16397, 500: 20644, 600: 24905, 700: 29129,
+                   800: 33275, 900: 37326, 1000: 41276, 1200: 48838, 1300: 52410}),
+    ('J', 57.953, {-200: -7890, -100: -4633, 0: 0, 25: 1277, 100: 5269, 200: 10779,
+                   300: 16327, 400: 21848, 500: 27393, 600: 33102, 700: 39132}),
+    ('N', 36.256, {-200: -3990, -100: -2407, 0: 0, 25: 659, 100: 2774, 200: 5913,
+                   300: 9341, 400: 12974, 500: 16748, 600: 20613, 700: 24527,
+                   800: 28455, 900: 32371, 1000: 36256, 1200: 43846, 1300: 47513}),
+    ('T', 52.18, {-200: -5603, -100: -3379, 0: 0, 25: 992, 100: 4279, 200: 9288,
+                  300: 14862, 400: 20872}),
+    ('E', 76.373, {-200: -8825, -100: -5237, 0: 0, 25: 1495, 100: 6319, 200: 13421,
+                   300: 21036, 400: 28946, 500: 36999, 600: 45093, 700: 53112,
+                   800: 61017, 900: 68787, 1000: 76373}),
+]
+JUNCTIONS = (0, 25)
+TOLERANCE = (1.0, 0.5)  #C, below 0 and from 0 up
+
+
+def build():
+    exe = os.path.join(HERE, 'build', 'linearize')
+    os.makedirs(os.path.dirname(exe), exist_ok=True)
+    subprocess.run([os.environ.get('CXX', 'c++'), '-O2', '-Wall', '-DARDUINO=105',
+                    '-I' + os.path.join(HERE, 'arduino'), '-I' + FIRMWARE, '-o', exe,
+                    os.path.join(HERE, 'linearize.cpp'), os.path.join(FIRMWARE, 'MAX31855.cpp')],
+                   check=True)
+    return exe
+
+
+def main():
+    exe = build()
+    cases = []
+    for type_index, (name, sensitivity, emf) in enumerate(TYPES):
+        for cj in JUNCTIONS:
+            for t, uv in sorted(emf.items()):
+                reading = (uv - emf[cj]) / sensitivity + cj  #what the chip says
+                cases.append((name, type_index, t, cj, round(reading * 4), cj * 16))
+    stdin = ''.join('%d %d %d\n' % (c[1], c[4], c[5]) for c in cases)
+    out = subprocess.run([exe], input=stdin, check=True, stdout=subprocess.PIPE,
+                         universal_newlines=True).stdout.split('\n')
+
+    worst = {}
+    bad = 0
+    for case, line in zip(cases, out):
+        name, _, t, cj, count, _ = case
+        fault, celsius = (int(v) for v in line.split())
+        err = celsius / 4.0 - t
+        if fault or abs(err) > TOLERANCE[t >= 0]:
+            bad += 1
+            print('%s at %dC, junction %dC: chip %.2f, got %s' %
+                  (name, t, cj, count / 4.0, 'fault %d' % fault if fault else '%.2f' % (celsius / 4.0)))
+        worst[name] = max(worst.get(name, 0), abs(err))
+    print('worst error: ' + ', '.join('%s %.2fC' % (n, worst[n]) for n, _, _ in TYPES))
+    print('ok' if not bad else 'FAILED')
+    return 0 if not bad else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())